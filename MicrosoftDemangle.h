@@ -0,0 +1,1823 @@
+//===- MicrosoftDemangle.h --------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a demangler for MSVC-style mangled symbols.
+//
+// This file has no dependencies on the rest of LLVM so that it can be
+// easily reused in other programs such as libcxxabi.
+//
+// By default, demangle() is compiled out of line in MicrosoftDemangle.cpp.
+// Define MS_DEMANGLE_HEADER_ONLY before including this file to use it as
+// a single-include library instead. Then the whole parser is visible to
+// the optimizer at every call site.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MICROSOFT_DEMANGLE_H
+#define MICROSOFT_DEMANGLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Most of the demangler is constexpr in C++17 or later, so that symbols
+// can be demangled at compile time with demangle_fixed().
+#if __cplusplus >= 201703L
+#define DEMANGLE_CONSTEXPR constexpr
+#define DEMANGLE_INLINE_VAR inline constexpr
+#else
+#define DEMANGLE_CONSTEXPR
+#define DEMANGLE_INLINE_VAR static
+#endif
+
+#ifdef MS_DEMANGLE_HEADER_ONLY
+#define MS_DEMANGLE_API inline
+#else
+#define MS_DEMANGLE_API
+#endif
+
+namespace ms_demangle {
+
+// A string class that does not own its contents.
+// This class provides a few utility functions for string manipulations.
+class String {
+public:
+  String() = default;
+  String(const String &) = default;
+  String(const std::string &s) : p(s.data()), len(s.size()) {}
+  DEMANGLE_CONSTEXPR String(const char *p)
+      : p(p), len(std::char_traits<char>::length(p)) {}
+  DEMANGLE_CONSTEXPR String(const char *p, size_t len) : p(p), len(len) {}
+  template <size_t N>
+  DEMANGLE_CONSTEXPR String(const char (&p)[N]) : p(p), len(N - 1) {}
+
+  std::string str() const { return {p, p + len}; }
+
+  DEMANGLE_CONSTEXPR bool empty() const { return len == 0; }
+
+  DEMANGLE_CONSTEXPR bool startswith(char c) const {
+    return len > 0 && *p == c;
+  }
+
+  DEMANGLE_CONSTEXPR bool startswith(String s) const {
+    return s.len <= len && std::char_traits<char>::compare(p, s.p, s.len) == 0;
+  }
+
+  DEMANGLE_CONSTEXPR bool startswith_digit() const {
+    return 0 < len && '0' <= p[0] && p[0] <= '9';
+  }
+
+  DEMANGLE_CONSTEXPR String substr(size_t off) const {
+    return {p + off, len - off};
+  }
+  DEMANGLE_CONSTEXPR String substr(size_t off, size_t length) const {
+    return {p + off, length};
+  }
+
+  DEMANGLE_CONSTEXPR bool operator==(const String s) const {
+    return len == s.len && std::char_traits<char>::compare(p, s.p, len) == 0;
+  }
+
+  DEMANGLE_CONSTEXPR void trim(size_t n) {
+    assert(n <= len);
+    p += n;
+    len -= n;
+  }
+
+  DEMANGLE_CONSTEXPR int get() {
+    if (len == 0)
+      return -1;
+    len--;
+    return *p++;
+  }
+
+  DEMANGLE_CONSTEXPR void unget(int c) {
+    if (c == -1)
+      return;
+    p--;
+    len++;
+  }
+
+  const char *p = nullptr;
+  size_t len = 0;
+};
+
+// Formats n in decimal into the end of tmp and returns the digits.
+inline DEMANGLE_CONSTEXPR String format_int(int64_t n, char (&tmp)[21]) {
+  char *p = tmp + sizeof(tmp);
+  uint64_t u = n < 0 ? -(uint64_t)n : n;
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (n < 0)
+    *--p = '-';
+  return {p, (size_t)(tmp + sizeof(tmp) - p)};
+}
+
+// Returns the number of trailing zero bits in x, which must not be zero.
+// MSVC's _BitScanForward64 can't be used in constant expressions, so
+// compilers without __builtin_ctzll get a loop.
+inline DEMANGLE_CONSTEXPR int ctz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  for (; !(x & 1); x >>= 1)
+    ++n;
+  return n;
+#endif
+}
+
+// Decodes the hex digits of a mangled number and the '@' that ends them.
+// Returns the number of characters read, or 0 if s doesn't start with
+// at most 16 digits and an '@'.
+inline DEMANGLE_CONSTEXPR size_t decode_hex_number(String s, uint64_t &value) {
+  uint64_t ret = 0;
+  size_t i = 0;
+
+  // Most numbers are short, and they are fastest to read one character
+  // at a time. Longer ones are read 8 characters at a time.
+  for (; i < 4 && i < s.len; ++i) {
+    char c = s.p[i];
+    if (c == '@') {
+      value = ret;
+      return i + 1;
+    }
+    if (c < 'A' || 'P' < c)
+      return 0;
+    ret = (ret << 4) + (c - 'A');
+  }
+
+  while (i + 8 <= s.len) {
+    // Load 8 characters. Compilers turn this into a single load, which
+    // they don't do for the same thing written as a loop.
+    const char *q = s.p + i;
+    uint64_t w = (uint64_t)(uint8_t)q[0] | (uint64_t)(uint8_t)q[1] << 8 |
+                 (uint64_t)(uint8_t)q[2] << 16 | (uint64_t)(uint8_t)q[3] << 24 |
+                 (uint64_t)(uint8_t)q[4] << 32 | (uint64_t)(uint8_t)q[5] << 40 |
+                 (uint64_t)(uint8_t)q[6] << 48 | (uint64_t)(uint8_t)q[7] << 56;
+
+    // XOR with '@' maps '@' to 0 and 'A' to 'P' to 1 to 16. Find the
+    // first byte that isn't in [1, 16], which must be the '@'.
+    const uint64_t ones = 0x0101010101010101;
+    const uint64_t high = 0x8080808080808080;
+    uint64_t x = w ^ (ones * '@');
+    uint64_t lo = x & ~high;
+    uint64_t nonzero = (lo + ~high) & high;
+    uint64_t above16 = (lo + ones * (0x7F - 16)) & high;
+    uint64_t stop = (x & high) | above16 | (~nonzero & high);
+
+    int n = stop ? ctz64(stop) / 8 : 8;
+    if ((n < 8 && (x >> (n * 8) & 0xFF) != 0) || i + n > 16)
+      break;
+
+    // Pack the n digits, which are x - 1, from the first byte (the
+    // lowest) to the last, into the top of a 32-bit number. Bytes after
+    // the digits are cleared first so they don't leak into them.
+    uint64_t d = x - ones;
+    if (n < 8)
+      d &= (1ULL << (n * 8)) - 1;
+    d = ((d << 4) | (d >> 8)) & 0x00FF00FF00FF00FF;
+    d = ((d << 8) | (d >> 16)) & 0x0000FFFF0000FFFF;
+    d = ((d << 16) | (d >> 32)) & 0xFFFFFFFF;
+
+    if (n == 8) {
+      ret = (ret << 32) | d;
+      i += 8;
+      continue;
+    }
+
+    // Shifting by 32 or more isn't defined for d, so n == 0 is special.
+    if (n > 0)
+      ret = (ret << (n * 4)) | (d >> (32 - n * 4));
+    value = ret;
+    return i + n + 1;
+  }
+
+  // Fewer than 8 characters are left, or the number is bad. Read the
+  // rest one at a time.
+  for (; i < s.len && i <= 16; ++i) {
+    char c = s.p[i];
+    if (c == '@') {
+      value = ret;
+      return i + 1;
+    }
+    if (i == 16 || c < 'A' || 'P' < c)
+      break;
+    ret = (ret << 4) + (c - 'A');
+  }
+
+  return 0;
+}
+
+// An append-only string buffer. This is used instead of std::stringstream
+// so that programs using the demangler don't need <iostream>, whose
+// static initialization shows up in the startup time of short-lived
+// processes.
+class OutputBuffer {
+public:
+  OutputBuffer &operator<<(String s) {
+    if (s.len > limit - buf.size()) {
+      overflow = true;
+      return *this;
+    }
+    buf.append(s.p, s.len);
+    return *this;
+  }
+
+  OutputBuffer &operator<<(int64_t n) {
+    char tmp[21];
+    return *this << format_int(n, tmp);
+  }
+
+  // Returns the last character written, or 0 if nothing has been written.
+  char back() const { return buf.empty() ? 0 : buf.back(); }
+
+  String view() const { return overflow ? String() : String(buf); }
+
+  bool overflowed() const { return overflow; }
+
+  // Output longer than n characters is dropped, and view() returns an
+  // empty string.
+  void set_limit(size_t n) { limit = n; }
+
+  // Empties the buffer but keeps its memory and its limit.
+  void clear() {
+    buf.clear();
+    overflow = false;
+  }
+
+private:
+  std::string buf;
+  size_t limit = SIZE_MAX;
+  bool overflow = false;
+};
+
+// An output buffer of N characters that doesn't allocate memory, so that
+// it can be used in constant expressions. If the output does not fit,
+// view() returns an empty string.
+template <size_t N> class FixedOutputBuffer {
+public:
+  DEMANGLE_CONSTEXPR FixedOutputBuffer &operator<<(String s) {
+    if (s.len > N - len) {
+      overflow = true;
+      return *this;
+    }
+    for (size_t i = 0; i < s.len; ++i)
+      buf[len++] = s.p[i];
+    return *this;
+  }
+
+  DEMANGLE_CONSTEXPR FixedOutputBuffer &operator<<(int64_t n) {
+    char tmp[21] = {};
+    return *this << format_int(n, tmp);
+  }
+
+  DEMANGLE_CONSTEXPR char back() const { return len ? buf[len - 1] : 0; }
+
+  DEMANGLE_CONSTEXPR String view() const {
+    return overflow ? String() : String(buf, len);
+  }
+
+  DEMANGLE_CONSTEXPR bool overflowed() const { return overflow; }
+
+private:
+  char buf[N] = {};
+  size_t len = 0;
+  bool overflow = false;
+};
+
+// This memory allocator is extremely fast, but it doesn't call dtors
+// for allocated objects. That means you can't use STL containers
+// (such as std::vector) with this allocator. But it pays off --
+// the demangler is 3x faster with this allocator compared to one with
+// STL containers.
+struct Type;
+struct Name;
+
+// Memory owned by the caller that an Arena allocates from before it
+// falls back to the heap.
+struct ArenaRegion {
+  uint8_t *p = nullptr;
+  size_t size = 0;
+};
+
+class Arena {
+public:
+  Type *new_type();
+  Name *new_name();
+
+  // This arena never runs out of memory.
+  bool full() const { return false; }
+
+  // Makes the arena allocate from r instead of its own buffer. r must be
+  // aligned to a pointer. Nothing in it is freed, so the next arena given
+  // the same region just starts over at the beginning.
+  void use_region(ArenaRegion r) {
+    if (r.size <= unit)
+      return;
+    region = r;
+    rewind();
+  }
+
+  // Frees everything allocated so far. Chunks taken from the heap are
+  // kept and handed out again.
+  void rewind() {
+    buf = region.p ? region.p : init_buf;
+    cap = region.p ? region.size : unit;
+    nused = 0;
+    nchunks = 0;
+  }
+
+  void *alloc(size_t size) {
+    assert(size < unit);
+
+    uint8_t *p = buf + nused;
+    nused += size;
+    if (nused < cap)
+      return p;
+
+    if (nchunks == buf2.size())
+      buf2.emplace_back(new uint8_t[Arena::unit]);
+    buf = buf2[nchunks++].get();
+    cap = unit;
+    nused = size;
+    return buf;
+  }
+
+private:
+  static constexpr size_t unit = 4096;
+
+  uint8_t *buf = init_buf;
+  alignas(sizeof(void *)) uint8_t init_buf[unit];
+  size_t cap = unit;
+  size_t nused = 0;
+  ArenaRegion region;
+  // Heap chunks. The first nchunks of them are in use.
+  std::vector<std::unique_ptr<uint8_t[]>> buf2;
+  size_t nchunks = 0;
+};
+
+// Storage classes
+enum {
+  Const = 1 << 0,
+  Volatile = 1 << 1,
+  Far = 1 << 2,
+  Huge = 1 << 3,
+  Unaligned = 1 << 4,
+  Restrict = 1 << 5,
+};
+
+// Calling conventions
+enum CallingConv : uint8_t {
+  Cdecl,
+  Pascal,
+  Thiscall,
+  Stdcall,
+  Fastcall,
+  Regcall,
+};
+
+// Primitive types and tag kinds with their mangled codes and the
+// keywords they are written as. The PrimTy enumerators, the parser's
+// decode table and the keywords written by write_pre() are all
+// generated from this list, so a new type only needs to be added here.
+// Tag kinds come first and are followed by a name.
+#define PRIM_TYPES(X)                                   \
+  X(Struct,      "U",   "struct")                       \
+  X(Union,       "T",   "union")                        \
+  X(Class,       "V",   "class")                        \
+  X(Enum,        "W4",  "enum")                         \
+  X(Coclass,     "_X",  "coclass")                      \
+  X(Cointerface, "_Y",  "cointerface")                  \
+  X(Void,        "X",   "void")                         \
+  X(Bool,        "_N",  "bool")                         \
+  X(Char,        "D",   "char")                         \
+  X(Schar,       "C",   "signed char")                  \
+  X(Uchar,       "E",   "unsigned char")                \
+  X(Short,       "F",   "short")                        \
+  X(Ushort,      "G",   "unsigned short")               \
+  X(Int,         "H",   "int")                          \
+  X(Uint,        "I",   "unsigned int")                 \
+  X(Long,        "J",   "long")                         \
+  X(Ulong,       "K",   "unsigned long")                \
+  X(Int8,        "_D",  "__int8")                       \
+  X(Uint8,       "_E",  "unsigned __int8")              \
+  X(Int16,       "_F",  "__int16")                      \
+  X(Uint16,      "_G",  "unsigned __int16")             \
+  X(Int32,       "_H",  "__int32")                      \
+  X(Uint32,      "_I",  "unsigned __int32")             \
+  X(Int64,       "_J",  "int64_t")                      \
+  X(Uint64,      "_K",  "uint64_t")                     \
+  X(Int128,      "_L",  "__int128")                     \
+  X(Uint128,     "_M",  "unsigned __int128")            \
+  X(Char8,       "_Q",  "char8_t")                      \
+  X(Char16,      "_S",  "char16_t")                     \
+  X(Char32,      "_U",  "char32_t")                     \
+  X(Wchar,       "_W",  "wchar_t")                      \
+  X(Float,       "M",   "float")                        \
+  X(Double,      "N",   "double")                       \
+  X(Ldouble,     "O",   "long double")                  \
+  X(Nullptr,     "$$T", "std::nullptr_t")
+
+// Types
+enum PrimTy : uint8_t {
+  Unknown,
+  None,
+  Function,
+  Ptr,
+  Ref,
+  RValueRef,
+  Array,
+
+  // Non-type template arguments
+  IntArg,
+  PtrArg,
+  RefArg,
+
+#define X(ty, code, keyword) ty,
+  PRIM_TYPES(X)
+#undef X
+};
+
+inline DEMANGLE_CONSTEXPR bool is_tag(PrimTy ty) {
+  return Struct <= ty && ty <= Cointerface;
+}
+
+inline DEMANGLE_CONSTEXPR String prim_keyword(PrimTy ty) {
+  switch (ty) {
+#define X(ty, code, keyword) case ty: return keyword;
+  PRIM_TYPES(X)
+#undef X
+  default: return "";
+  }
+}
+
+// Maps mangled codes in PRIM_TYPES to types. Codes are a single
+// character or '_' followed by a character. "W4" and "$$T" share their
+// prefixes with other constructs, so read_var_type() handles them.
+struct PrimCodes {
+  DEMANGLE_CONSTEXPR PrimCodes() {
+#define X(ty, code, keyword) add(ty, code);
+    PRIM_TYPES(X)
+#undef X
+  }
+
+  DEMANGLE_CONSTEXPR void add(PrimTy ty, String code) {
+    if (code.len == 1)
+      single[(uint8_t)code.p[0]] = ty;
+    else if (code.len == 2 && code.p[0] == '_')
+      underscore[(uint8_t)code.p[1]] = ty;
+  }
+
+  PrimTy single[256] = {};
+  PrimTy underscore[256] = {};
+};
+
+DEMANGLE_INLINE_VAR const PrimCodes prim_codes;
+
+// Pointer models. 64-bit symbols have the __ptr64 qualifier 'E' on
+// pointers, references and member functions, and 32-bit symbols don't.
+// PtrAuto accepts both, so it can be used for mixed-architecture input.
+enum PtrModel : uint8_t {
+  Ptr32,
+  Ptr64,
+  PtrAuto,
+};
+
+// Function classes
+enum FuncClass : uint8_t {
+  Public = 1 << 0,
+  Protected = 1 << 1,
+  Private = 1 << 2,
+  Global = 1 << 3,
+  Static = 1 << 4,
+  Virtual = 1 << 5,
+  FFar = 1 << 6,
+};
+
+// Parse errors and their messages.
+#define ERROR_CODES(X)                                                   \
+  X(ErrBadNumber,     "bad number")                                      \
+  X(ErrMissingAt,     "read_string: missing '@'")                        \
+  X(ErrNameRef,       "name reference too large")                        \
+  X(ErrOperator,      "unknown operator name")                           \
+  X(ErrFuncClass,     "unknown func class")                              \
+  X(ErrCallingConv,   "unknown calling convention")                      \
+  X(ErrStorageClass,  "unknown storage class")                           \
+  X(ErrPrimType,      "unknown primitive type")                          \
+  X(ErrBackref,       "invalid backreference")                           \
+  X(ErrArrayDim,      "invalid array dimension")                         \
+  X(ErrExpected,      "expected")                                        \
+  X(ErrCapacity,      "capacity exceeded")                               \
+  X(ErrBadChar,       "invalid character")
+
+enum ErrorCode : uint8_t {
+  NoError,
+#define X(code, message) code,
+  ERROR_CODES(X)
+#undef X
+};
+
+// The number of error codes, including NoError.
+enum : size_t {
+  NumErrorCodes = 1
+#define X(code, message) +1
+  ERROR_CODES(X)
+#undef X
+};
+
+// A parse error. This records where parsing failed instead of building
+// a message, so that failing is cheap and doesn't allocate memory.
+struct Error {
+  DEMANGLE_CONSTEXPR bool empty() const { return code == NoError; }
+
+  // Returns a message such as "unknown primitive type: Z".
+  std::string str() const;
+
+  ErrorCode code = NoError;
+
+  // The rest of the input where the error was found.
+  String input;
+
+  // The expected string. Valid if code is ErrExpected.
+  String expected;
+};
+
+// The number of demangle() calls that failed with each error code, so
+// that a program can tell which parts of the grammar its input hits
+// without logging every failure.
+struct ErrorStats {
+  uint64_t count[NumErrorCodes] = {};
+
+  uint64_t total() const {
+    return std::accumulate(count, count + NumErrorCodes, (uint64_t)0);
+  }
+};
+
+// Returns the failures counted so far on all threads.
+MS_DEMANGLE_API ErrorStats error_stats();
+
+// Returns a short description of an error code.
+inline const char *error_message(ErrorCode code) {
+  switch (code) {
+  case NoError: return "no error";
+#define X(code, message) case code: return message;
+  ERROR_CODES(X)
+#undef X
+  }
+  return "";
+}
+
+// Returns the name of an error code, such as "ErrBadNumber", for
+// output that is read by programs.
+inline const char *error_name(ErrorCode code) {
+  switch (code) {
+  case NoError: return "NoError";
+#define X(code, message) case code: return #code;
+  ERROR_CODES(X)
+#undef X
+  }
+  return "";
+}
+
+inline std::string Error::str() const {
+  if (empty())
+    return "";
+  if (code == ErrExpected)
+    return expected.str() + " expected, but got " + input.str();
+  return error_message(code) + (": " + input.str());
+}
+
+// Represents an identifier which may be a template.
+struct Name {
+  // Name read from an input string.
+  String str;
+
+  // Overloaded operators are represented as special names in mangled symbols.
+  // If this is an operator name, "op" has an operator name (e.g. ">>").
+  // Otherwise, empty.
+  String op;
+
+  // Template parameters. Null if not a template.
+  Type *params = nullptr;
+
+  // Nested names (e.g. "A::B::C") are represented as a linked list.
+  Name *next = nullptr;
+};
+
+// The type class. Mangled symbols are first parsed and converted to
+// this type and then converted to string.
+struct Type {
+  // Primitive type such as Int.
+  PrimTy prim = Unknown;
+
+  // Represents a type X in "a pointer to X", "a reference to X",
+  // "an array of X", or "a function returning X".
+  Type *ptr = nullptr;
+
+  uint8_t sclass = 0;  // storage class
+  CallingConv calling_conv = Cdecl;
+  FuncClass func_class = (FuncClass)0;
+
+  uint32_t len = 0; // valid if prim == Array
+  int64_t num = 0;  // valid if prim == IntArg
+
+  // Valid if prim is one of (Struct, Union, Class, Enum, PtrArg, RefArg).
+  // If prim is Ptr, this is non-null for a pointer to member and is the
+  // name of the class.
+  Name *name = nullptr;
+
+  // Function parameters.
+  Type *params = nullptr;
+
+  // Lists of types (e.g. function parameters) are represented as linked lists.
+  Type *next = nullptr;
+};
+
+inline Type *Arena::new_type() { return new (alloc(sizeof(Type))) Type; }
+inline Name *Arena::new_name() { return new (alloc(sizeof(Name))) Name; }
+
+// A fixed-capacity allocator of N types and N names. It doesn't allocate
+// memory, so that it can be used in constant expressions. When it runs
+// out, it keeps returning a spare node and full() becomes true. Handing
+// out the last of the N nodes doesn't make it full.
+template <size_t N> class FixedArena {
+public:
+  DEMANGLE_CONSTEXPR Type *new_type() {
+    if (ntypes == N) {
+      overflowed = true;
+      spare_type = Type();
+      return &spare_type;
+    }
+    return &types[ntypes++];
+  }
+
+  DEMANGLE_CONSTEXPR Name *new_name() {
+    if (nnames == N) {
+      overflowed = true;
+      spare_name = Name();
+      return &spare_name;
+    }
+    return &names[nnames++];
+  }
+
+  DEMANGLE_CONSTEXPR bool full() const { return overflowed; }
+
+private:
+  Type types[N];
+  Name names[N];
+  Type spare_type;
+  Name spare_name;
+  size_t ntypes = 0;
+  size_t nnames = 0;
+  bool overflowed = false;
+};
+
+// Demangler class takes the main role in demangling symbols.
+// It has a set of functions to parse mangled symbols into Type instnaces.
+// It also has a set of functions to cnovert Type instances to strings.
+//
+// The pointer model is a template parameter so that each variant
+// compiles without runtime checks for it.
+//
+// If Capacity is zero, memory is allocated on the heap as needed.
+// Otherwise, the demangler has room for Capacity nodes and Capacity
+// characters of output, and doesn't allocate memory. In C++17 or later,
+// such a demangler can be used in constant expressions.
+template <PtrModel Model, size_t Capacity = 0> class Demangler {
+public:
+  DEMANGLE_CONSTEXPR Demangler(String s) : input(s) {}
+
+  // You are supposed to call parse() first and then check if error is
+  // still empty. After that, call str() to get a result.
+  DEMANGLE_CONSTEXPR void parse();
+  std::string str();
+
+  // Same as str() but returns a string owned by this demangler. If the
+  // result doesn't fit in the output buffer, sets error to ErrCapacity
+  // and returns an empty string.
+  DEMANGLE_CONSTEXPR String render();
+
+  // Makes render() fail if the result is longer than n characters. A
+  // symbol can refer back to names many times, so the result can be
+  // far longer than the symbol. Only for demanglers without Capacity.
+  void set_output_limit(size_t n) { os.set_limit(n); }
+
+  // Allocates nodes from r. Call it before parse(). Only for demanglers
+  // without Capacity.
+  void use_region(ArenaRegion r) { arena.use_region(r); }
+
+  // Starts over with a new symbol. The memory of the arena and of the
+  // output buffer is kept, so a demangler that is reused for many
+  // symbols stops allocating once it has seen a large one. Only for
+  // demanglers without Capacity.
+  void reset(String s) {
+    input = s;
+    type = Type();
+    symbol = nullptr;
+    arena.rewind();
+    backrefs = NameTable();
+    os.clear();
+    error = Error();
+  }
+
+  // Parse error. Empty if there's no error.
+  Error error;
+
+private:
+  // Parser functions. This is a recursive-descendent parser.
+  DEMANGLE_CONSTEXPR Name *read_symbol(Type &ty);
+  DEMANGLE_CONSTEXPR void read_var_type(Type &ty);
+  void read_member_func_type(Type &ty);
+
+  DEMANGLE_CONSTEXPR int64_t read_number();
+  DEMANGLE_CONSTEXPR String read_string(bool memorize);
+  DEMANGLE_CONSTEXPR void memorize_string(String s, Name *tmpl = nullptr);
+  DEMANGLE_CONSTEXPR Name *read_name();
+  DEMANGLE_CONSTEXPR void read_anon_namespace(Name *name);
+  DEMANGLE_CONSTEXPR void read_template_name(Name *name);
+  DEMANGLE_CONSTEXPR void read_func_ptr(Type &ty);
+  DEMANGLE_CONSTEXPR void read_member_func_ptr(Type &ty);
+  DEMANGLE_CONSTEXPR void read_func_params(Type &ty);
+  DEMANGLE_CONSTEXPR void read_symbol_arg(Type &ty, PrimTy prim);
+  DEMANGLE_CONSTEXPR void read_operator(Name *);
+  DEMANGLE_CONSTEXPR String read_operator_name();
+  String read_until(const std::string &s);
+  DEMANGLE_CONSTEXPR PrimTy read_prim_type();
+  DEMANGLE_CONSTEXPR int read_func_class();
+  DEMANGLE_CONSTEXPR int8_t read_func_access_class();
+  DEMANGLE_CONSTEXPR CallingConv read_calling_conv();
+  DEMANGLE_CONSTEXPR void read_func_return_type(Type &ty);
+  DEMANGLE_CONSTEXPR int8_t read_storage_class();
+  DEMANGLE_CONSTEXPR int8_t read_storage_class_for_return();
+  DEMANGLE_CONSTEXPR int8_t read_pointee_storage_class(Name **cls);
+
+  DEMANGLE_CONSTEXPR void read_ptr64();
+  DEMANGLE_CONSTEXPR void read_class(Type &ty, PrimTy prim);
+  DEMANGLE_CONSTEXPR void read_pointee(Type &ty, PrimTy prim);
+  DEMANGLE_CONSTEXPR void read_array(Type &ty);
+  DEMANGLE_CONSTEXPR Type *read_params();
+
+  DEMANGLE_CONSTEXPR int peek() {
+    return (input.len == 0) ? -1 : input.p[0];
+  }
+
+  DEMANGLE_CONSTEXPR bool consume(String s) {
+    if (!input.startswith(s))
+      return false;
+    input.trim(s.len);
+    return true;
+  }
+
+  DEMANGLE_CONSTEXPR void expect(String s) {
+    if (!consume(s) && error.empty()) {
+      error.code = ErrExpected;
+      error.expected = s;
+      error.input = input;
+    }
+  }
+
+  // Records an error. Only the first one is kept because later ones
+  // are usually caused by it.
+  DEMANGLE_CONSTEXPR void fail(ErrorCode code, String at) {
+    if (error.empty()) {
+      error.code = code;
+      error.input = at;
+    }
+  }
+
+  DEMANGLE_CONSTEXPR Type *new_type() {
+    Type *ty = arena.new_type();
+    if (arena.full())
+      fail(ErrCapacity, input);
+    return ty;
+  }
+
+  DEMANGLE_CONSTEXPR Name *new_name() {
+    Name *name = arena.new_name();
+    if (arena.full())
+      fail(ErrCapacity, input);
+    return name;
+  }
+
+  // Mangled symbol. read_* functions shorten this string
+  // as they parse it.
+  String input;
+
+  // A parsed mangled symbol.
+  Type type;
+
+  // The main symbol name. (e.g. "ns::foo" in "int ns::foo()".)
+  Name *symbol = nullptr;
+
+  // Memory allocator.
+  typename std::conditional<Capacity == 0, Arena, FixedArena<Capacity>>::type
+      arena;
+
+  // The first 10 names in a mangled name can be back-referenced by
+  // special name @[0-9]. This is a storage for the first 10 names.
+  // A template instance is stored as its mangled form along with its
+  // parsed name, which is non-null only for template instances.
+  struct NameTable {
+    String names[10];
+    Name *tmpls[10] = {};
+    size_t num_names = 0;
+  };
+  NameTable backrefs;
+
+  // Functions to convert Type to String.
+  DEMANGLE_CONSTEXPR void write_pre(Type &ty);
+  DEMANGLE_CONSTEXPR void write_post(Type &ty);
+  DEMANGLE_CONSTEXPR void write_class(Name *name, String s);
+  DEMANGLE_CONSTEXPR void write_params(Type *ty);
+  DEMANGLE_CONSTEXPR void write_name(Name *name);
+  DEMANGLE_CONSTEXPR void write_tmpl_params(Name *name);
+  DEMANGLE_CONSTEXPR void write_operator(Name *name);
+  DEMANGLE_CONSTEXPR void write_space();
+
+  // The result is written to this buffer.
+  typename std::conditional<Capacity == 0, OutputBuffer,
+                            FixedOutputBuffer<Capacity>>::type os;
+};
+
+// Parser entry point.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::parse() {
+  // MSVC-style mangled symbols must start with '?'.
+  if (!consume("?")) {
+    symbol = new_name();
+    symbol->str = input;
+    type.prim = Unknown;
+    return;
+  }
+
+  symbol = read_symbol(type);
+}
+
+// Reads a symbol name followed by its type. This is used for the main
+// symbol as well as for symbols referred to by template arguments.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR Name *Demangler<Model, Capacity>::read_symbol(Type &ty) {
+  // What follows is a main symbol name. This may include
+  // namespaces or class names.
+  Name *name = read_name();
+
+  // Read a variable.
+  if (consume("3")) {
+    read_var_type(ty);
+    if (ty.prim == Ptr || ty.prim == Ref || ty.prim == RValueRef)
+      read_ptr64();
+    Name *cls = nullptr;
+    read_pointee_storage_class(&cls);
+    return name;
+  }
+
+  // Read a non-member function.
+  if (consume("Y")) {
+    ty.prim = Function;
+    ty.calling_conv = read_calling_conv();
+    ty.ptr = new_type();
+    ty.ptr->sclass = read_storage_class_for_return();
+    read_var_type(*ty.ptr);
+    read_func_params(ty);
+    return name;
+  }
+
+  // Read a member function.
+  ty.prim = Function;
+  ty.func_class = (FuncClass)read_func_class();
+
+  // Static member functions have no 'this' pointer to qualify.
+  if (!(ty.func_class & Static)) {
+    read_ptr64();
+    ty.sclass = read_func_access_class();
+  }
+  ty.calling_conv = read_calling_conv();
+
+  ty.ptr = new_type();
+  ty.ptr->sclass = read_storage_class_for_return();
+  read_func_return_type(*ty.ptr);
+  read_func_params(ty);
+  return name;
+}
+
+// Sometimes numbers are encoded in mangled symbols. For example,
+// "int (*x)[20]" is a valid C type (x is a pointer to an array of
+// length 20), so we need some way to embed numbers as part of symbols.
+// This function parses it.
+//
+// <number>               ::= [?] <non-negative integer>
+//
+// <non-negative integer> ::= <decimal digit> # when 1 <= Number <= 10
+//                        ::= <hex digit>+ @  # when Numbrer == 0 or >= 10
+//
+// <hex-digit>            ::= [A-P]           # A = 0, B = 1, ...
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR int64_t Demangler<Model, Capacity>::read_number() {
+  bool neg = consume("?");
+
+  if (input.startswith_digit()) {
+    int64_t ret = *input.p - '0' + 1;
+    input.trim(1);
+    return neg ? -ret : ret;
+  }
+
+  uint64_t ret = 0;
+  size_t n = decode_hex_number(input, ret);
+  if (n == 0) {
+    fail(ErrBadNumber, input);
+    return 0;
+  }
+  input.trim(n);
+  return (int64_t)(neg ? 0 - ret : ret);
+}
+
+// Read until the next '@'.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR String Demangler<Model, Capacity>::read_string(bool memorize) {
+  for (size_t i = 0; i < input.len; ++i) {
+    if (input.p[i] != '@')
+      continue;
+    String ret = input.substr(0, i);
+    input.trim(i + 1);
+
+    if (memorize)
+      memorize_string(ret);
+    return ret;
+  }
+
+  fail(ErrMissingAt, input);
+  return "";
+}
+
+// First 10 strings can be referenced by special names ?0, ?1, ..., ?9.
+// Memorize it. If it is printed differently from s, as a template
+// instance or an anonymous namespace is, s is its mangled form and tmpl
+// is what back-references resolve to.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::memorize_string(String s, Name *tmpl) {
+  NameTable &t = backrefs;
+  if (t.num_names >= sizeof(t.names) / sizeof(*t.names))
+    return;
+  for (size_t i = 0; i < t.num_names; ++i)
+    if (s == t.names[i])
+      return;
+  t.names[t.num_names] = s;
+  t.tmpls[t.num_names] = tmpl;
+  t.num_names++;
+}
+
+// Parses a name in the form of A@B@C@@ which represents C::B::A.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR Name *Demangler<Model, Capacity>::read_name() {
+  Name *head = nullptr;
+
+  while (error.empty() && !consume("@")) {
+    Name *elem = new_name();
+
+    if (input.startswith_digit()) {
+      size_t i = input.p[0] - '0';
+      if (i >= backrefs.num_names) {
+        fail(ErrNameRef, input);
+        return {};
+      }
+      input.trim(1);
+      if (Name *tmpl = backrefs.tmpls[i]) {
+        elem->str = tmpl->str;
+        elem->params = tmpl->params;
+      } else {
+        elem->str = backrefs.names[i];
+      }
+    } else if (input.startswith("?A0x")) {
+      // Anonymous namespace.
+      read_anon_namespace(elem);
+    } else if (input.startswith("?$")) {
+      // Class template.
+      read_template_name(elem);
+    } else if (consume("?")) {
+      // Overloaded operator.
+      read_operator(elem);
+    } else {
+      // Non-template functions or classes. Lambda closure types
+      // (e.g. "<lambda_1>") are also mangled as regular identifiers.
+      elem->str = read_string(true);
+    }
+
+    elem->next = head;
+    head = elem;
+  }
+
+  return head;
+}
+
+// Anonymous namespaces are mangled as ?A0x<hash>@ where <hash> is unique
+// to a translation unit. The hash is never printed, so all occurrences
+// share one static string. Namespaces with different hashes are still
+// different names, so the mangled form is memorized, as with templates.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_anon_namespace(Name *name) {
+  String orig = input;
+  input.trim(4);
+  read_string(false);
+  name->str = "`anonymous namespace'";
+  if (error.empty())
+    memorize_string(orig.substr(0, input.p - orig.p - 1), name);
+}
+
+// Template instances are mangled as ?$<name><template-args>@. The name
+// and the arguments have their own back-reference table, and the whole
+// instance is memorized as a single name in the enclosing table.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_template_name(Name *name) {
+  String orig = input;
+  input.trim(2);
+
+  NameTable outer = backrefs;
+  backrefs = NameTable();
+  name->str = read_string(true);
+  name->params = read_params();
+  expect("@");
+  backrefs = outer;
+
+  if (error.empty())
+    memorize_string(orig.substr(0, input.p - orig.p), name);
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_func_ptr(Type &ty) {
+  Type *tp = new_type();
+  tp->prim = Function;
+  tp->ptr = new_type();
+  read_var_type(*tp->ptr);
+  read_func_params(*tp);
+
+  ty.prim = Ptr;
+  ty.ptr = tp;
+}
+
+// <member-function-pointer> ::= P8 <class name> <this cvr> <calling conv>
+//                               <return type> <parameters>
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_member_func_ptr(Type &ty) {
+  ty.prim = Ptr;
+  ty.name = read_name();
+
+  Type *tp = new_type();
+  tp->prim = Function;
+  read_ptr64();
+  tp->sclass = read_func_access_class();
+  tp->calling_conv = read_calling_conv();
+  tp->ptr = new_type();
+  tp->ptr->sclass = read_storage_class_for_return();
+  read_var_type(*tp->ptr);
+  read_func_params(*tp);
+  ty.ptr = tp;
+}
+
+// Reads a function parameter list and its terminator.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_func_params(Type &ty) {
+  ty.params = read_params();
+
+  if (input.startswith("@Z"))
+    input.trim(2);
+  else if (input.startswith("Z"))
+    input.trim(1);
+}
+
+// Reads a template argument referring to another symbol, as in
+// "tmpl<&x>". The symbol is mangled in full, including its type.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_symbol_arg(Type &ty, PrimTy prim) {
+  expect("?");
+  ty.prim = prim;
+  ty.ptr = new_type();
+  ty.name = read_symbol(*ty.ptr);
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_operator(Name *name) {
+  name->op = read_operator_name();
+  if (error.empty() && peek() != '@')
+    name->str = read_string(true);
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR String Demangler<Model, Capacity>::read_operator_name() {
+  String orig = input;
+
+  switch (input.get()) {
+  case '0': return "ctor";
+  case '1': return "dtor";
+  case '2': return " new";
+  case '3': return " delete";
+  case '4': return "=";
+  case '5': return ">>";
+  case '6': return "<<";
+  case '7': return "!";
+  case '8': return "==";
+  case '9': return "!=";
+  case 'A': return "[]";
+  case 'C': return "->";
+  case 'D': return "*";
+  case 'E': return "++";
+  case 'F': return "--";
+  case 'G': return "-";
+  case 'H': return "+";
+  case 'I': return "&";
+  case 'J': return "->*";
+  case 'K': return "/";
+  case 'L': return "%";
+  case 'M': return "<";
+  case 'N': return "<=";
+  case 'O': return ">";
+  case 'P': return ">=";
+  case 'Q': return ",";
+  case 'R': return "()";
+  case 'S': return "~";
+  case 'T': return "^";
+  case 'U': return "|";
+  case 'V': return "&&";
+  case 'W': return "||";
+  case 'X': return "*=";
+  case 'Y': return "+=";
+  case 'Z': return "-=";
+  case '_':
+    switch (input.get()) {
+    case '0': return "/=";
+    case '1': return "%=";
+    case '2': return ">>=";
+    case '3': return "<<=";
+    case '4': return "&=";
+    case '5': return "|=";
+    case '6': return "^=";
+    case 'U': return " new[]";
+    case 'V': return " delete[]";
+    case '_':
+      if (consume("L"))
+        return " co_await";
+    }
+  }
+
+  fail(ErrOperator, orig);
+  return "";
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR int Demangler<Model, Capacity>::read_func_class() {
+  switch (int c = input.get()) {
+  case 'A': return Private;
+  case 'B': return Private | FFar;
+  case 'C': return Private | Static;
+  case 'D': return Private | Static;
+  case 'E': return Private | Virtual;
+  case 'F': return Private | Virtual;
+  case 'I': return Protected;
+  case 'J': return Protected | FFar;
+  case 'K': return Protected | Static;
+  case 'L': return Protected | Static | FFar;
+  case 'M': return Protected | Virtual;
+  case 'N': return Protected | Virtual | FFar;
+  case 'Q': return Public;
+  case 'R': return Public | FFar;
+  case 'S': return Public | Static;
+  case 'T': return Public | Static | FFar;
+  case 'U': return Public | Virtual;
+  case 'V': return Public | Virtual | FFar;
+  case 'Y': return Global;
+  case 'Z': return Global | FFar;
+  default:
+    input.unget(c);
+    fail(ErrFuncClass, input);
+    return 0;
+  }
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR int8_t Demangler<Model, Capacity>::read_func_access_class() {
+  switch (int c = input.get()) {
+  case 'A': return 0;
+  case 'B': return Const;
+  case 'C': return Volatile;
+  case 'D': return Const | Volatile;
+  default:
+    input.unget(c);
+    return 0;
+  }
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR CallingConv Demangler<Model, Capacity>::read_calling_conv() {
+  String orig = input;
+
+  switch (input.get()) {
+  case 'A': return Cdecl;
+  case 'B': return Cdecl;
+  case 'C': return Pascal;
+  case 'E': return Thiscall;
+  case 'G': return Stdcall;
+  case 'I': return Fastcall;
+  default:
+    fail(ErrCallingConv, orig);
+    return Cdecl;
+  }
+};
+
+// <return-type> ::= <type>
+//               ::= @ # structors (they have no declared return type)
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_func_return_type(Type &ty) {
+  if (consume("@"))
+    ty.prim = None;
+  else
+    read_var_type(ty);
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR int8_t Demangler<Model, Capacity>::read_storage_class() {
+  switch (int c = input.get()) {
+  case 'A': return 0;
+  case 'B': return Const;
+  case 'C': return Volatile;
+  case 'D': return Const | Volatile;
+  case 'E': return Far;
+  case 'F': return Const | Far;
+  case 'G': return Volatile | Far;
+  case 'H': return Const | Volatile | Far;
+  default:
+    input.unget(c);
+    return 0;
+  }
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR int8_t Demangler<Model, Capacity>::read_storage_class_for_return() {
+  if (!consume("?"))
+    return 0;
+  String orig = input;
+
+  switch (input.get()) {
+  case 'A': return 0;
+  case 'B': return Const;
+  case 'C': return Volatile;
+  case 'D': return Const | Volatile;
+  default:
+    fail(ErrStorageClass, orig);
+    return 0;
+  }
+}
+
+// Pointers to data members have one of Q, R, S or T instead of a regular
+// storage class, followed by the class name. The class name is stored
+// to *cls.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR int8_t Demangler<Model, Capacity>::read_pointee_storage_class(Name **cls) {
+  switch (int c = input.get()) {
+  case 'Q': *cls = read_name(); return 0;
+  case 'R': *cls = read_name(); return Const;
+  case 'S': *cls = read_name(); return Volatile;
+  case 'T': *cls = read_name(); return Const | Volatile;
+  default:
+    input.unget(c);
+    return read_storage_class();
+  }
+}
+
+// Reads a variable type.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_var_type(Type &ty) {
+  if (consume("$0")) {
+    ty.prim = IntArg;
+    ty.num = read_number();
+    return;
+  }
+
+  if (consume("$1")) {
+    read_symbol_arg(ty, PtrArg);
+    return;
+  }
+
+  if (consume("$E")) {
+    read_symbol_arg(ty, RefArg);
+    return;
+  }
+
+  if (consume("$$Q")) {
+    read_pointee(ty, RValueRef);
+    return;
+  }
+
+  if (consume("$$R")) {
+    read_pointee(ty, RValueRef);
+    ty.sclass = Volatile;
+    return;
+  }
+
+  if (consume("W4")) {
+    read_class(ty, Enum);
+    return;
+  }
+
+  if (consume("$$T")) {
+    ty.prim = Nullptr;
+    return;
+  }
+
+  if (consume("P6A")) {
+    read_func_ptr(ty);
+    return;
+  }
+
+  if (consume("P8")) {
+    read_member_func_ptr(ty);
+    return;
+  }
+
+  if (consume("Q8")) {
+    read_member_func_ptr(ty);
+    ty.sclass = Const;
+    return;
+  }
+
+  switch (int c = input.get()) {
+  case 'A':
+    read_pointee(ty, Ref);
+    return;
+  case 'P':
+    read_pointee(ty, Ptr);
+    return;
+  case 'Q':
+    read_pointee(ty, Ptr);
+    ty.sclass = Const;
+    return;
+  case 'Y':
+    read_array(ty);
+    return;
+  default:
+    input.unget(c);
+    ty.prim = read_prim_type();
+    if (is_tag(ty.prim))
+      ty.name = read_name();
+    return;
+  }
+}
+
+// Reads a primitive type or a tag kind.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR PrimTy Demangler<Model, Capacity>::read_prim_type() {
+  String orig = input;
+
+  PrimTy ty = Unknown;
+  int c = input.get();
+  if (c == '_') {
+    c = input.get();
+    if (c != -1)
+      ty = prim_codes.underscore[(uint8_t)c];
+  } else if (c != -1) {
+    ty = prim_codes.single[(uint8_t)c];
+  }
+
+  if (ty != Unknown)
+    return ty;
+  fail(ErrPrimType, orig);
+  return Unknown;
+}
+
+// Reads the __ptr64 qualifier. This compiles to an expect(), a consume()
+// or nothing depending on the pointer model.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_ptr64() {
+  if (Model == Ptr64)
+    expect("E");
+  else if (Model == PtrAuto)
+    consume("E");
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_class(Type &ty, PrimTy prim) {
+  ty.prim = prim;
+  ty.name = read_name();
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_pointee(Type &ty, PrimTy prim) {
+  ty.prim = prim;
+  read_ptr64();
+  ty.ptr = new_type();
+  ty.ptr->sclass = read_pointee_storage_class(&ty.name);
+  read_var_type(*ty.ptr);
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::read_array(Type &ty) {
+  String orig = input;
+  int64_t dimension = read_number();
+  // Each dimension takes at least one character.
+  if (dimension <= 0 || dimension > (int64_t)input.len) {
+    fail(ErrArrayDim, orig);
+    return;
+  }
+
+  Type *tp = &ty;
+  for (int64_t i = 0; i < dimension; ++i) {
+    tp->prim = Array;
+    tp->len = (uint32_t)read_number();
+    tp->ptr = new_type();
+    tp = tp->ptr;
+  }
+
+  if (consume("$$C")) {
+    if (consume("B"))
+      ty.sclass = Const;
+    else if (consume("C") || consume("D"))
+      ty.sclass = Const | Volatile;
+    else if (!consume("A"))
+      fail(ErrStorageClass, input);
+  }
+
+  read_var_type(*tp);
+}
+
+// Reads a function or a template parameters.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR Type * Demangler<Model, Capacity>::read_params() {
+  // Within the same parameter list, you can backreference the first 10 types.
+  Type *backref[10] = {};
+  int idx = 0;
+
+  Type *head = nullptr;
+  Type **tp = &head;
+  while (error.empty() && !input.startswith('@') && !input.startswith('Z')) {
+    if (input.startswith_digit()) {
+      int n = input.p[0] - '0';
+      if (n >= idx) {
+        fail(ErrBackref, input);
+        return nullptr;
+      }
+      input.trim(1);
+
+      *tp = new_type();
+      **tp = *backref[n];
+      (*tp)->next = nullptr;
+      tp = &(*tp)->next;
+      continue;
+    }
+
+    size_t len = input.len;
+
+    *tp = new_type();
+    read_var_type(**tp);
+
+    // Single-letter types are ignored for backreferences because
+    // memorizing them doesn't save anything.
+    if (idx <= 9 && len - input.len > 1)
+      backref[idx++] = *tp;
+    tp = &(*tp)->next;
+  }
+  return head;
+}
+
+// Converts an AST to a string.
+//
+// Converting an AST representing a C++ type to a string is tricky due
+// to the bad grammar of the C++ declaration inherited from C. You have
+// to construct a string from inside to outside. For example, if a type
+// X is a pointer to a function returning int, the order you create a
+// string becomes something like this:
+//
+//   (1) X is a pointer: *X
+//   (2) (1) is a function returning int: int (*X)()
+//
+// So you cannot construct a result just by appending strings to a result.
+//
+// To deal with this, we split the function into two. write_pre() writes
+// the "first half" of type declaration, and write_post() writes the
+// "second half". For example, write_pre() writes a return type for a
+// function and write_post() writes an parameter list.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR String Demangler<Model, Capacity>::render() {
+  write_pre(type);
+  write_name(symbol);
+  write_post(type);
+  if (os.overflowed())
+    fail(ErrCapacity, input);
+  return os.view();
+}
+
+template <PtrModel Model, size_t Capacity>
+std::string Demangler<Model, Capacity>::str() {
+  return render().str();
+}
+
+// Write the "first half" of a given type.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::write_pre(Type &ty) {
+  switch (ty.prim) {
+  case Unknown:
+  case None:
+    break;
+  case Function:
+    write_pre(*ty.ptr);
+    return;
+  case Ptr:
+  case Ref:
+  case RValueRef:
+    write_pre(*ty.ptr);
+
+    // "[]" and "()" (for function parameters) take precedence over "*",
+    // so "int *x(int)" means "x is a function returning int *". We need
+    // parentheses to supercede the default precedence. (e.g. we want to
+    // emit something like "int (*x)(int)".)
+    if (ty.ptr->prim == Function || ty.ptr->prim == Array)
+      os << "(";
+
+    // Pointers to members are written as "klass::*".
+    if (ty.name) {
+      write_name(ty.name);
+      os << "::";
+    }
+
+    if (ty.prim == Ptr)
+      os << "*";
+    else if (ty.prim == Ref)
+      os << "&";
+    else
+      os << "&&";
+    break;
+  case Array:
+    write_pre(*ty.ptr);
+    break;
+
+  case IntArg: os << ty.num; break;
+  case PtrArg: os << "&"; write_name(ty.name); break;
+  case RefArg: write_name(ty.name); break;
+
+  default:
+    if (is_tag(ty.prim))
+      write_class(ty.name, prim_keyword(ty.prim));
+    else
+      os << prim_keyword(ty.prim);
+    break;
+  }
+
+  if (ty.sclass & Const) {
+    write_space();
+    os << "const";
+  }
+  if (ty.sclass & Volatile) {
+    write_space();
+    os << "volatile";
+  }
+}
+
+// Write the "second half" of a given type.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::write_post(Type &ty) {
+  if (ty.prim == Function) {
+    os << "(";
+    write_params(ty.params);
+    os << ")";
+    if (ty.sclass & Const)
+      os << "const";
+    if (ty.sclass & Volatile) {
+      write_space();
+      os << "volatile";
+    }
+    return;
+  }
+
+  if (ty.prim == Ptr || ty.prim == Ref || ty.prim == RValueRef) {
+    if (ty.ptr->prim == Function || ty.ptr->prim == Array)
+      os << ")";
+    write_post(*ty.ptr);
+    return;
+  }
+
+  if (ty.prim == Array) {
+    os << "[" << ty.len << "]";
+    write_post(*ty.ptr);
+  }
+}
+
+// Write a function or template parameter list.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::write_params(Type *params) {
+  for (Type *tp = params; tp; tp = tp->next) {
+    if (tp != params)
+      os << ",";
+    write_pre(*tp);
+    write_post(*tp);
+  }
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::write_class(Name *name, String s) {
+  os << s << " ";
+  write_name(name);
+}
+
+// Write a name read by read_name().
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::write_name(Name *name) {
+  if (!name)
+    return;
+  write_space();
+
+  // Print out namespaces or outer class names.
+  for (; name->next; name = name->next) {
+    os << name->str;
+    write_tmpl_params(name);
+    os << "::";
+  }
+
+  // Print out a regular name.
+  if (name->op.empty()) {
+    os << name->str;
+    write_tmpl_params(name);
+    return;
+  }
+
+  // Print out ctor or dtor.
+  if (name->op == "ctor" || name->op == "dtor") {
+    os << name->str;
+    write_params(name->params);
+    os << "::";
+    if (name->op == "dtor")
+      os << "~";
+    os << name->str;
+    return;
+  }
+
+  // Print out an overloaded operator.
+  if (!name->str.empty())
+    os << name->str << "::";
+  os << "operator" << name->op;
+}
+
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::write_tmpl_params(Name *name) {
+  if (!name->params)
+    return;
+  os << "<";
+  write_params(name->params);
+  os << ">";
+}
+
+// Writes a space if the last token does not end with a punctuation.
+template <PtrModel Model, size_t Capacity>
+DEMANGLE_CONSTEXPR void Demangler<Model, Capacity>::write_space() {
+  char c = os.back();
+  if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z'))
+    os << " ";
+}
+
+// A string of up to N characters returned by demangle_fixed(). It can be
+// a constexpr value.
+template <size_t N> struct FixedString {
+  DEMANGLE_CONSTEXPR operator String() const { return {buf, len}; }
+
+  char buf[N] = {};
+  size_t len = 0;
+};
+
+// Demangles a symbol without allocating memory. The result is empty if
+// the symbol is invalid or if it doesn't fit in N nodes or N characters.
+// In C++17 or later, this can be evaluated at compile time:
+//
+//   constexpr auto name = demangle_fixed<64>("?x@@3HA"); // "int x"
+template <size_t N, PtrModel Model = PtrAuto>
+DEMANGLE_CONSTEXPR FixedString<N> demangle_fixed(String s) {
+  Demangler<Model, N> demangler(s);
+  demangler.parse();
+
+  FixedString<N> ret;
+  if (!demangler.error.empty())
+    return ret;
+  String out = demangler.render();
+  for (size_t i = 0; i < out.len; ++i)
+    ret.buf[i] = out.p[i];
+  ret.len = out.len;
+  return ret;
+}
+
+// Demangles a symbol and appends the result to out. On failure, returns
+// false and stores the error to *err unless err is null, and counts the
+// error for error_stats(). On success, returns true. Results longer than
+// max_len characters fail with ErrCapacity. If region isn't empty, the
+// parse tree is built in it.
+MS_DEMANGLE_API bool demangle(String s, std::string &out, Error *err = nullptr,
+                              PtrModel model = PtrAuto,
+                              size_t max_len = SIZE_MAX,
+                              ArenaRegion region = ArenaRegion());
+
+#if defined(MS_DEMANGLE_HEADER_ONLY) || defined(MS_DEMANGLE_IMPLEMENTATION)
+// Failures are counted per thread, so that counting one is a relaxed
+// store to a cache line no other thread writes. error_stats() sums the
+// counters of the live threads and of the threads that have exited.
+struct ThreadErrorCounters {
+  std::atomic<uint64_t> count[NumErrorCodes] = {};
+};
+
+struct ErrorCounterList {
+  std::mutex mu;
+  std::vector<ThreadErrorCounters *> live;
+  ErrorStats exited;
+};
+
+MS_DEMANGLE_API ErrorCounterList &error_counter_list() {
+  static ErrorCounterList list;
+  return list;
+}
+
+// Registers the counters of a thread on its first failure and folds
+// them into the total when the thread exits.
+struct ThreadErrorCountersHandle {
+  ThreadErrorCountersHandle() {
+    ErrorCounterList &list = error_counter_list();
+    std::lock_guard<std::mutex> lock(list.mu);
+    list.live.push_back(&counters);
+  }
+
+  ~ThreadErrorCountersHandle() {
+    ErrorCounterList &list = error_counter_list();
+    std::lock_guard<std::mutex> lock(list.mu);
+    for (size_t i = 0; i < NumErrorCodes; ++i)
+      list.exited.count[i] += counters.count[i].load(std::memory_order_relaxed);
+    list.live.erase(std::find(list.live.begin(), list.live.end(), &counters));
+  }
+
+  ThreadErrorCounters counters;
+};
+
+MS_DEMANGLE_API void count_error(ErrorCode code) {
+  static thread_local ThreadErrorCountersHandle handle;
+  // Only this thread writes its counters, so no read-modify-write is
+  // needed.
+  std::atomic<uint64_t> &c = handle.counters.count[code];
+  c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+MS_DEMANGLE_API ErrorStats error_stats() {
+  ErrorCounterList &list = error_counter_list();
+  std::lock_guard<std::mutex> lock(list.mu);
+  ErrorStats ret = list.exited;
+  for (ThreadErrorCounters *t : list.live)
+    for (size_t i = 0; i < NumErrorCodes; ++i)
+      ret.count[i] += t->count[i].load(std::memory_order_relaxed);
+  return ret;
+}
+
+template <PtrModel Model>
+inline bool demangle_as(String s, std::string &out, Error *err,
+                        size_t max_len, ArenaRegion region) {
+  Demangler<Model> demangler(s);
+  demangler.set_output_limit(max_len);
+  demangler.use_region(region);
+  demangler.parse();
+  String res;
+  if (demangler.error.empty())
+    res = demangler.render();
+  if (!demangler.error.empty()) {
+    count_error(demangler.error.code);
+    if (err)
+      *err = demangler.error;
+    return false;
+  }
+
+  out.append(res.p, res.len);
+  return true;
+}
+
+MS_DEMANGLE_API bool demangle(String s, std::string &out, Error *err,
+                              PtrModel model, size_t max_len,
+                              ArenaRegion region) {
+  switch (model) {
+  case Ptr32: return demangle_as<Ptr32>(s, out, err, max_len, region);
+  case Ptr64: return demangle_as<Ptr64>(s, out, err, max_len, region);
+  case PtrAuto: return demangle_as<PtrAuto>(s, out, err, max_len, region);
+  }
+  return false;
+}
+#endif
+
+} // namespace ms_demangle
+
+#endif
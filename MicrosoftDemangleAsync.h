@@ -0,0 +1,644 @@
+//===- MicrosoftDemangleAsync.h ---------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines AsyncDemangler, which demangles symbols on its own
+// worker threads for programs such as services that can't wait for a
+// symbol to be parsed. submit() queues a symbol and returns a ticket,
+// and the result comes back with that ticket from poll() or wait().
+// Symbols and results are passed through lock-free queues, so neither
+// side takes a lock unless it has nothing to do and goes to sleep.
+//
+// In C++20, coroutines can co_await co_demangle() or read a
+// DemangleStream instead.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MICROSOFT_DEMANGLE_ASYNC_H
+#define MICROSOFT_DEMANGLE_ASYNC_H
+
+#include "MicrosoftDemangle.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <functional>
+#include <optional>
+#define MS_DEMANGLE_HAVE_COROUTINES
+#endif
+#endif
+
+namespace ms_demangle {
+
+// A bounded queue that any number of threads can push to and pop from
+// without locks. This is Dmitry Vyukov's bounded MPMC queue: each cell
+// has a sequence number that says whether it is ready to be written or
+// read in the current lap around the ring, so producers and consumers
+// only contend on the position counters.
+template <typename T> class MpmcQueue {
+public:
+  // The capacity is rounded up to a power of two.
+  explicit MpmcQueue(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity)
+      n *= 2;
+    cells.reset(new Cell[n]);
+    mask = n - 1;
+    for (size_t i = 0; i < n; ++i)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  MpmcQueue(const MpmcQueue &) = delete;
+  MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+  size_t capacity() const { return mask + 1; }
+
+  // Returns false if the queue is full.
+  bool try_push(T &v) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &c = cells[pos & mask];
+      size_t seq = c.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          c.value = std::move(v);
+          c.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Returns false if the queue is empty.
+  bool try_pop(T &v) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &c = cells[pos & mask];
+      size_t seq = c.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          v = std::move(c.value);
+          c.seq.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // True if there is nothing to pop. Only a hint while other threads
+  // push or pop.
+  bool empty() const {
+    size_t pos = tail.load(std::memory_order_acquire);
+    size_t seq = cells[pos & mask].seq.load(std::memory_order_acquire);
+    return (intptr_t)seq - (intptr_t)(pos + 1) < 0;
+  }
+
+private:
+  // Cells and counters get their own cache lines so that threads working
+  // on neighboring cells don't slow each other down.
+  struct alignas(64) Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+
+// Puts threads to sleep until a lock-free queue has something for them.
+// The side that fills the queue only takes the lock if a thread is
+// actually asleep.
+class Waiters {
+public:
+  // Sleeps until ready() returns true.
+  template <typename Pred> void wait(Pred ready) {
+    std::unique_lock<std::mutex> lock(mu);
+    num_waiting.fetch_add(1);
+    // Pairs with the fence in notify_all(): either we see what was
+    // pushed, or the notifier sees that we are waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv.wait(lock, ready);
+    num_waiting.fetch_sub(1);
+  }
+
+  void notify_all() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_waiting.load(std::memory_order_relaxed) == 0)
+      return;
+    { std::lock_guard<std::mutex> lock(mu); }
+    cv.notify_all();
+  }
+
+private:
+  std::mutex mu;
+  std::condition_variable cv;
+  std::atomic<size_t> num_waiting{0};
+};
+
+// The result of a symbol submitted to an AsyncDemangler.
+struct AsyncResult {
+  uint64_t ticket = 0;
+  // The demangled symbol. Empty if it couldn't be demangled.
+  std::string result;
+  Error error;
+
+  bool ok() const { return error.empty(); }
+};
+
+class AsyncDemangler {
+public:
+  // At most capacity symbols can be in flight, counting those whose
+  // results haven't been taken yet.
+  explicit AsyncDemangler(
+      unsigned threads = std::thread::hardware_concurrency(),
+      size_t capacity = 4096, PtrModel model = PtrAuto)
+      : requests(capacity), results(capacity), model(model) {
+    this->capacity = requests.capacity();
+    for (unsigned i = 0; i < std::max(threads, 1U); ++i) {
+      switch (model) {
+      case Ptr32: workers.emplace_back([this] { run<Ptr32>(); }); break;
+      case Ptr64: workers.emplace_back([this] { run<Ptr64>(); }); break;
+      case PtrAuto: workers.emplace_back([this] { run<PtrAuto>(); }); break;
+      }
+    }
+  }
+
+  // Waits for the symbols that are still queued or set aside by post()
+  // to be demangled and their callbacks to run, and drops the results
+  // that haven't been taken.
+  ~AsyncDemangler() {
+    stop.store(true);
+    have_requests.notify_all();
+    for (std::thread &t : workers)
+      t.join();
+
+    // Symbols set aside by post() may be waiting for room that only
+    // poll() would make, and the last callbacks may have queued more.
+    // They are demangled here, so that every callback runs, e.g. to
+    // resume a coroutine suspended in co_demangle().
+    switch (model) {
+    case Ptr32: drain<Ptr32>(); break;
+    case Ptr64: drain<Ptr64>(); break;
+    case PtrAuto: drain<PtrAuto>(); break;
+    }
+  }
+
+  AsyncDemangler(const AsyncDemangler &) = delete;
+  AsyncDemangler &operator=(const AsyncDemangler &) = delete;
+
+  // Queues s and returns its ticket, which is never 0, or returns 0 if
+  // capacity symbols are already in flight. s must stay valid as long as
+  // its result, whose error refers to it. Never blocks.
+  uint64_t try_submit(String s) { return try_submit(s, nullptr, nullptr); }
+
+  // Same as try_submit(s), but done(ctx, result) is called on a worker
+  // thread when s is demangled, and the result doesn't go to poll(). It
+  // is called once the worker has finished the batch s was taken in, or
+  // by ~AsyncDemangler() on the thread that destroys this.
+  uint64_t try_submit(String s, void (*done)(void *, AsyncResult &),
+                      void *ctx) {
+    uint64_t n = issued.load(std::memory_order_relaxed);
+    do {
+      // n may be stale and behind taken, in which case the difference
+      // is negative and the exchange below fails and reloads it.
+      if ((int64_t)(n - taken.load(std::memory_order_acquire)) >=
+          (int64_t)capacity)
+        return 0;
+    } while (!issued.compare_exchange_weak(n, n + 1,
+                                           std::memory_order_relaxed));
+
+    Request req{n + 1, s, done, ctx};
+    // There is room for every symbol in flight, but a cell that a worker
+    // has just popped may take a moment to be released.
+    while (!requests.try_push(req))
+      std::this_thread::yield();
+    have_requests.notify_all();
+    return n + 1;
+  }
+
+  // Same as try_submit(), but waits for room if capacity symbols are in
+  // flight. Callers that submit more than capacity symbols before taking
+  // any results would wait forever.
+  uint64_t submit(String s, void (*done)(void *, AsyncResult &) = nullptr,
+                  void *ctx = nullptr) {
+    for (;;) {
+      if (uint64_t ticket = try_submit(s, done, ctx))
+        return ticket;
+      std::this_thread::yield();
+    }
+  }
+
+  // Same as try_submit(s, done, ctx), but never fails or waits. If
+  // capacity symbols are in flight, s is set aside and submitted as soon
+  // as one of them is done, in the order of post() calls. This suits
+  // callers that run on a reactor thread or on a worker.
+  void post(String s, void (*done)(void *, AsyncResult &), void *ctx) {
+    if (num_deferred.load() == 0 && try_submit(s, done, ctx))
+      return;
+    {
+      std::lock_guard<std::mutex> lock(deferred_mu);
+      deferred.push_back(Request{0, s, done, ctx});
+      num_deferred.store(deferred.size());
+    }
+    // Everything in flight may have finished before s was set aside, in
+    // which case nothing else would submit it.
+    submit_deferred();
+  }
+
+  // Takes a result if one is ready. Results come in the order they are
+  // finished, not in the order of tickets. Never blocks.
+  bool poll(AsyncResult &r) {
+    if (!results.try_pop(r))
+      return false;
+    taken.fetch_add(1);
+    if (num_deferred.load())
+      submit_deferred();
+    return true;
+  }
+
+  // Waits for a result and takes it.
+  void wait(AsyncResult &r) {
+    while (!poll(r))
+      have_results.wait([&] { return !results.empty(); });
+  }
+
+private:
+  struct Request {
+    uint64_t ticket;
+    String symbol;
+    void (*done)(void *, AsyncResult &);
+    void *ctx;
+  };
+
+  // Called whenever a symbol leaves the count in flight. taken and
+  // num_deferred are sequentially consistent, so either post() sees the
+  // room or the thread that made it sees the symbol set aside.
+  void submit_deferred() {
+    std::lock_guard<std::mutex> lock(deferred_mu);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!deferred.empty()) {
+      const Request &r = deferred.front();
+      if (!try_submit(r.symbol, r.done, r.ctx))
+        break;
+      deferred.pop_front();
+    }
+    num_deferred.store(deferred.size());
+  }
+
+  template <PtrModel Model>
+  static AsyncResult demangle_request(Demangler<Model> &demangler,
+                                      const Request &r) {
+    AsyncResult res;
+    res.ticket = r.ticket;
+    demangler.reset(r.symbol);
+    demangler.parse();
+    String out;
+    if (demangler.error.empty())
+      out = demangler.render();
+    if (demangler.error.empty()) {
+      res.result.assign(out.p, out.len);
+    } else {
+      count_error(demangler.error.code);
+      res.error = demangler.error;
+    }
+    return res;
+  }
+
+  // A worker keeps one demangler for its whole life, so that its arena
+  // and output buffer are already allocated and in its cache. It takes
+  // up to batch_size symbols at a time and wakes waiters once per batch.
+  template <PtrModel Model> void run() {
+    static const size_t batch_size = 32;
+    Demangler<Model> demangler((String()));
+    std::vector<Request> batch;
+    std::vector<std::pair<const Request *, AsyncResult>> callbacks;
+    batch.reserve(batch_size);
+    callbacks.reserve(batch_size);
+
+    for (;;) {
+      batch.clear();
+      Request req;
+      while (batch.size() < batch_size && requests.try_pop(req))
+        batch.push_back(req);
+
+      if (batch.empty()) {
+        // Spin a little before sleeping, since a busy service submits
+        // symbols faster than a thread can go to sleep and wake up.
+        bool found = false;
+        for (int i = 0; i < 64 && !found; ++i) {
+          std::this_thread::yield();
+          found = !requests.empty();
+        }
+        if (!found)
+          have_requests.wait([&] { return stop.load() || !requests.empty(); });
+        if (stop.load() && requests.empty())
+          return;
+        continue;
+      }
+
+      for (const Request &r : batch) {
+        AsyncResult res = demangle_request(demangler, r);
+        if (r.done) {
+          callbacks.emplace_back(&r, std::move(res));
+          continue;
+        }
+        // Results are only taken out after they are counted in flight,
+        // so this can only fail for the moment it takes a caller to
+        // release a cell.
+        while (!results.try_push(res))
+          std::this_thread::yield();
+      }
+      have_results.notify_all();
+
+      // Callbacks run after the whole batch, so that one that takes a
+      // while, such as a coroutine resumed on this thread, doesn't hold
+      // up the other symbols of the batch. Their symbols leave the count
+      // in flight first, so that callbacks can submit more.
+      if (callbacks.empty())
+        continue;
+      taken.fetch_add(callbacks.size());
+      if (num_deferred.load())
+        submit_deferred();
+      for (auto &c : callbacks)
+        c.first->done(c.first->ctx, c.second);
+      callbacks.clear();
+    }
+  }
+
+  // Demangles what is left after the workers have stopped, on the
+  // calling thread. Results that would go to poll() are dropped.
+  template <PtrModel Model> void drain() {
+    Demangler<Model> demangler((String()));
+    for (;;) {
+      Request r;
+      if (!requests.try_pop(r)) {
+        std::lock_guard<std::mutex> lock(deferred_mu);
+        if (deferred.empty())
+          return;
+        r = deferred.front();
+        deferred.pop_front();
+        num_deferred.store(deferred.size());
+      }
+      AsyncResult res = demangle_request(demangler, r);
+      if (r.done)
+        r.done(r.ctx, res);
+    }
+  }
+
+  MpmcQueue<Request> requests;
+  MpmcQueue<AsyncResult> results;
+  Waiters have_requests;
+  Waiters have_results;
+
+  size_t capacity;
+  PtrModel model;
+  alignas(64) std::atomic<uint64_t> issued{0};
+  alignas(64) std::atomic<uint64_t> taken{0};
+  std::atomic<bool> stop{false};
+
+  std::mutex deferred_mu;
+  std::deque<Request> deferred;
+  std::atomic<size_t> num_deferred{0};
+
+  std::vector<std::thread> workers;
+};
+
+#ifdef MS_DEMANGLE_HAVE_COROUTINES
+// A coroutine that awaits a symbol is suspended while a worker demangles
+// it and is resumed on that worker, so a reactor thread is never held up
+// by a symbol that takes milliseconds to parse. A coroutine that must go
+// on on its reactor thread should hop back to it after the await.
+//
+//   AsyncResult r = co_await co_demangle(async, symbol);
+
+// The AsyncDemangler that co_demangle(String) uses, with one worker per
+// core.
+inline AsyncDemangler &default_async_demangler() {
+  static AsyncDemangler async;
+  return async;
+}
+
+class DemangleAwaitable {
+public:
+  DemangleAwaitable(AsyncDemangler &async, String s)
+      : async(async), symbol(s) {}
+
+  bool await_ready() const { return false; }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    handle = h;
+    // The coroutine may be resumed on a worker, and this object freed,
+    // before post() returns, so nothing of it is touched afterwards.
+    async.post(symbol, &done, this);
+  }
+
+  AsyncResult await_resume() { return std::move(result); }
+
+private:
+  static void done(void *ctx, AsyncResult &r) {
+    DemangleAwaitable *self = (DemangleAwaitable *)ctx;
+    self->result = std::move(r);
+    self->handle.resume();
+  }
+
+  AsyncDemangler &async;
+  String symbol;
+  std::coroutine_handle<> handle;
+  AsyncResult result;
+};
+
+inline DemangleAwaitable co_demangle(AsyncDemangler &async, String s) {
+  return DemangleAwaitable(async, s);
+}
+
+inline DemangleAwaitable co_demangle(String s) {
+  return DemangleAwaitable(default_async_demangler(), s);
+}
+
+// An asynchronous generator of the results for a stream of symbols, in
+// the order of the stream. Up to window symbols are demangled ahead of
+// the reader, on the workers of an AsyncDemangler.
+//
+//   DemangleStream stream(async, symbols, n);
+//   while (std::optional<AsyncResult> r = co_await stream.next())
+//     ...
+//
+// A reader that has to wait is resumed on the worker that finished the
+// symbol it waited for. Only one coroutine may read a stream at a time.
+//
+// The stream may be destroyed before it is read to the end. Symbols that
+// are still being demangled then finish on their own and their results
+// are dropped, so the symbols must stay valid until the AsyncDemangler
+// is done with them. The stream must not be destroyed while its reader
+// is suspended in next(), since a worker may resume the reader at any
+// time.
+class DemangleStream {
+public:
+  // source(s) sets s to the next symbol and returns true, or returns
+  // false at the end of the stream.
+  DemangleStream(AsyncDemangler &async, std::function<bool(String &)> source,
+                 size_t window = 64)
+      : async(async), source(std::move(source)),
+        window(std::max<size_t>(window, 1)),
+        shared(new Shared(this->window)) {}
+
+  DemangleStream(AsyncDemangler &async, const String *symbols, size_t n,
+                 size_t window = 64)
+      : DemangleStream(
+            async,
+            [=, i = (size_t)0](String &s) mutable {
+              if (i == n)
+                return false;
+              s = symbols[i++];
+              return true;
+            },
+            window) {}
+
+  // Doesn't wait for the symbols that are being demangled.
+  ~DemangleStream() {
+    assert(at_end() ||
+           head_slot().state.load(std::memory_order_relaxed) != Waiting);
+    release(shared);
+  }
+
+  DemangleStream(const DemangleStream &) = delete;
+  DemangleStream &operator=(const DemangleStream &) = delete;
+
+  class Next {
+  public:
+    explicit Next(DemangleStream &stream) : stream(stream) {}
+
+    bool await_ready() {
+      stream.fill();
+      return stream.at_end() || stream.head_slot().state.load(
+                                    std::memory_order_acquire) == Done;
+    }
+
+    // Suspends unless the result came in since await_ready().
+    bool await_suspend(std::coroutine_handle<> h) {
+      stream.shared->reader = h;
+      int state = Pending;
+      return stream.head_slot().state.compare_exchange_strong(
+          state, Waiting, std::memory_order_acq_rel,
+          std::memory_order_acquire);
+    }
+
+    std::optional<AsyncResult> await_resume() {
+      if (stream.at_end())
+        return std::nullopt;
+      AsyncResult r = std::move(stream.head_slot().result);
+      ++stream.head;
+      stream.fill();
+      return r;
+    }
+
+  private:
+    DemangleStream &stream;
+  };
+
+  // Returns an awaitable for the next result, or for std::nullopt at the
+  // end of the stream.
+  Next next() { return Next(*this); }
+
+private:
+  enum { Pending, Waiting, Done };
+
+  struct Shared;
+
+  struct Slot {
+    Shared *shared;
+    std::atomic<int> state{Pending};
+    AsyncResult result;
+  };
+
+  // What the workers touch. It is held by the stream and by each symbol
+  // in flight, and the last of them to let go deletes it, so the stream
+  // can go away while symbols are in flight.
+  struct Shared {
+    explicit Shared(size_t window) : slots(new Slot[window]) {
+      for (size_t i = 0; i < window; ++i)
+        slots[i].shared = this;
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    std::coroutine_handle<> reader;
+    std::atomic<size_t> refs{1};
+  };
+
+  static void release(Shared *shared) {
+    if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete shared;
+  }
+
+  Slot &head_slot() { return shared->slots[head % window]; }
+  bool at_end() const { return head == submitted; }
+
+  // Submits symbols until window of them are ahead of the reader.
+  void fill() {
+    while (!eof && submitted - head < window) {
+      String s;
+      if (!source(s)) {
+        eof = true;
+        return;
+      }
+      Slot &slot = shared->slots[submitted % window];
+      slot.state.store(Pending, std::memory_order_relaxed);
+      shared->refs.fetch_add(1, std::memory_order_relaxed);
+      ++submitted;
+      async.post(s, &done, &slot);
+    }
+  }
+
+  static void done(void *ctx, AsyncResult &r) {
+    Slot *slot = (Slot *)ctx;
+    Shared *shared = slot->shared;
+    slot->result = std::move(r);
+    // Waiting means that the reader is suspended on this slot, so the
+    // stream is still there, since it can't be destroyed until the
+    // reader is resumed.
+    if (slot->state.exchange(Done, std::memory_order_acq_rel) == Waiting)
+      shared->reader.resume();
+    release(shared);
+  }
+
+  AsyncDemangler &async;
+  std::function<bool(String &)> source;
+  size_t window;
+  Shared *shared;
+  // Results before head have been read, and symbols before submitted
+  // have been submitted.
+  size_t head = 0;
+  size_t submitted = 0;
+  bool eof = false;
+};
+#endif
+
+} // namespace ms_demangle
+
+#endif
@@ -0,0 +1,644 @@
+//===- MicrosoftDemangleBatch.h ---------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a thread pool, a function to demangle many symbols
+// in parallel on it, and a line splitter to feed it. It is separate from
+// MicrosoftDemangle.h so that programs demangling one symbol at a time
+// don't need threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MICROSOFT_DEMANGLE_BATCH_H
+#define MICROSOFT_DEMANGLE_BATCH_H
+
+#include "MicrosoftDemangle.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MS_DEMANGLE_HAVE_SIMD
+#endif
+
+// MS_DEMANGLE_PREFETCH(p, rw) asks for the cache line at p to be loaded,
+// for writing if rw is 1. It does nothing where there is no way to ask.
+#if defined(__GNUC__)
+#define MS_DEMANGLE_PREFETCH(p, rw) __builtin_prefetch((p), (rw))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define MS_DEMANGLE_PREFETCH(p, rw)                                            \
+  _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#else
+#define MS_DEMANGLE_PREFETCH(p, rw) ((void)(p), (void)(rw))
+#endif
+
+namespace ms_demangle {
+
+// A fixed-size pool of worker threads. Tasks are run in the order they
+// are submitted.
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned n = std::thread::hardware_concurrency()) {
+    for (unsigned i = 0; i < std::max(n, 1U); ++i)
+      workers.emplace_back([this] { run(); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      stop = true;
+    }
+    cv.notify_all();
+    for (std::thread &t : workers)
+      t.join();
+  }
+
+  void submit(std::function<void()> fn) {
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      tasks.push_back(std::move(fn));
+    }
+    cv.notify_one();
+  }
+
+  unsigned size() const { return workers.size(); }
+
+private:
+  void run() {
+    for (;;) {
+      std::function<void()> fn;
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [this] { return stop || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+        fn = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      fn();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mu;
+  std::condition_variable cv;
+  bool stop = false;
+};
+
+// Returns a rough estimate of how long it takes to demangle s. Time is
+// mostly linear in the length of a symbol, but each template name
+// ("?$") also opens a new back-reference table and nests the output, so
+// symbols with many of them are slower than their length suggests.
+inline size_t demangle_cost(String s) {
+  size_t cost = s.len;
+  for (size_t i = 0; i + 1 < s.len; ++i)
+    if (s.p[i] == '?' && s.p[i + 1] == '$')
+      cost += 32;
+  return cost;
+}
+
+// A schedule for demangling a batch. Symbols are ordered from the most
+// to the least expensive and grouped into tasks of roughly equal cost,
+// so that an expensive symbol is never the last thing left when the
+// other threads run out of work, and cheap symbols don't pay a trip to
+// the shared counter each.
+struct BatchPlan {
+  // Indices into the input, most expensive first.
+  std::vector<uint32_t> order;
+  // Task i covers order[tasks[i]] to order[tasks[i + 1]].
+  std::vector<uint32_t> tasks;
+
+  size_t num_tasks() const { return tasks.empty() ? 0 : tasks.size() - 1; }
+};
+
+// Each task costs about this much, unless it's a single symbol that
+// costs more.
+const size_t batch_task_cost = 4096;
+
+inline BatchPlan plan_batch(const String *in, size_t n) {
+  // Costs are sorted into buckets rather than sorted exactly, which is
+  // linear in n and close enough for scheduling.
+  const size_t num_buckets = 256;
+  const size_t bucket_width = 16;
+  auto bucket = [&](size_t cost) {
+    return num_buckets - 1 - std::min(cost / bucket_width, num_buckets - 1);
+  };
+
+  std::vector<size_t> cost(n);
+  std::vector<size_t> count(num_buckets + 1);
+  for (size_t i = 0; i < n; ++i) {
+    cost[i] = demangle_cost(in[i]);
+    ++count[bucket(cost[i])];
+  }
+  for (size_t b = 0, sum = 0; b <= num_buckets; ++b) {
+    size_t c = count[b];
+    count[b] = sum;
+    sum += c;
+  }
+
+  BatchPlan plan;
+  plan.order.resize(n);
+  for (size_t i = 0; i < n; ++i)
+    plan.order[count[bucket(cost[i])]++] = i;
+
+  size_t acc = 0;
+  plan.tasks.push_back(0);
+  for (size_t i = 0; i < n; ++i) {
+    acc += cost[plan.order[i]];
+    if (acc >= batch_task_cost) {
+      plan.tasks.push_back(i + 1);
+      acc = 0;
+    }
+  }
+  if (plan.tasks.back() != n)
+    plan.tasks.push_back(n);
+  return plan;
+}
+
+// Calls fn(i) for each i in [0, n) on the pool and the calling thread,
+// where i is the number of a task. Tasks are handed out in order from a
+// shared counter, so threads that get cheap tasks come back for more.
+//
+// The calling thread waits only for helpers that have started. Helpers
+// that the pool gets to after the calling thread has run out of tasks
+// return without doing anything. So it's safe to call this from a task
+// on the same pool, where the helpers are queued behind the caller, or
+// with a pool whose threads are gone, as in a child process after
+// fork(), though in that case the calling thread does all the work.
+template <typename Fn>
+void run_tasks(size_t n, ThreadPool &pool, Fn fn) {
+  std::atomic<size_t> next(0);
+  auto work = [&] {
+    for (size_t i; (i = next.fetch_add(1)) < n;)
+      fn(i);
+  };
+
+  // Helpers are useful only if there is more than one task.
+  size_t helpers = n ? std::min<size_t>(pool.size(), n - 1) : 0;
+  if (helpers == 0) {
+    work();
+    return;
+  }
+
+  // Helpers may outlive this call, so the state they share with it is
+  // on the heap. next and fn are only touched by helpers that
+  // registered in running before closed was set.
+  struct State {
+    std::mutex mu;
+    std::condition_variable cv;
+    size_t running = 0;
+    bool closed = false;
+  };
+  auto state = std::make_shared<State>();
+  for (size_t i = 0; i < helpers; ++i) {
+    pool.submit([state, &work] {
+      {
+        std::lock_guard<std::mutex> lock(state->mu);
+        if (state->closed)
+          return;
+        ++state->running;
+      }
+      work();
+      std::lock_guard<std::mutex> lock(state->mu);
+      if (--state->running == 0)
+        state->cv.notify_one();
+    });
+  }
+
+  work();
+  std::unique_lock<std::mutex> lock(state->mu);
+  state->closed = true;
+  state->cv.wait(lock, [&] { return state->running == 0; });
+}
+
+// Where the arenas of batch workers get their memory. With the default,
+// each demangler starts in a buffer on the stack and takes 4 KiB chunks
+// from the heap when that runs out. The others back the arenas with a
+// 2 MiB region per worker thread, mapped with a transparent huge page
+// (madvise) or with an explicit one (MAP_HUGETLB), so that a worker's
+// parse trees stay within one TLB entry. Explicit huge pages must be
+// reserved by the administrator; if there are none, the region falls
+// back to a transparent one.
+enum HugePages { HugePagesOff, HugePagesTransparent, HugePagesExplicit };
+
+class WorkerArena {
+public:
+  static const size_t size = 2 << 20;
+
+  explicit WorkerArena(HugePages pages) {
+#ifdef __linux__
+    if (pages == HugePagesOff)
+      return;
+    if (pages == HugePagesExplicit) {
+      void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED) {
+        mem = (uint8_t *)p;
+        explicit_pages = true;
+        return;
+      }
+    }
+
+    // A transparent huge page needs a 2 MiB aligned range, so twice as
+    // much is mapped and the ends are trimmed.
+    void *p = mmap(nullptr, size * 2, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      return;
+    uintptr_t begin = (uintptr_t)p;
+    uintptr_t aligned = (begin + size - 1) & ~(uintptr_t)(size - 1);
+    if (aligned != begin)
+      munmap(p, aligned - begin);
+    munmap((void *)(aligned + size), begin + size - aligned);
+    mem = (uint8_t *)aligned;
+#ifdef MADV_HUGEPAGE
+    madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    // Fault the page in now rather than in the first symbol.
+    *(volatile uint8_t *)mem = 0;
+#endif
+  }
+
+  ~WorkerArena() {
+#ifdef __linux__
+    if (mem)
+      munmap(mem, size);
+#endif
+  }
+
+  WorkerArena(const WorkerArena &) = delete;
+  WorkerArena &operator=(const WorkerArena &) = delete;
+
+  // Empty if the region couldn't be mapped, in which case demanglers use
+  // their own memory.
+  ArenaRegion region() const {
+    ArenaRegion r;
+    if (mem) {
+      r.p = mem;
+      r.size = size;
+    }
+    return r;
+  }
+
+  // True if the region is backed by an explicit huge page. Whether the
+  // kernel gave a transparent one shows in AnonHugePages in
+  // /proc/self/smaps.
+  bool is_explicit() const { return explicit_pages; }
+
+private:
+  uint8_t *mem = nullptr;
+  bool explicit_pages = false;
+};
+
+// Returns the region of the calling thread for the given kind of pages,
+// mapping it on first use. It lives as long as the thread, so the pool
+// workers map theirs once and reuse it for every symbol.
+inline ArenaRegion worker_arena_region(HugePages pages) {
+  if (pages == HugePagesOff)
+    return ArenaRegion();
+  static thread_local std::unique_ptr<WorkerArena> arenas[3];
+  std::unique_ptr<WorkerArena> &a = arenas[pages];
+  if (!a)
+    a.reset(new WorkerArena(pages));
+  return a->region();
+}
+
+// Symbols are visited in cost order, not in input order, so the next
+// symbol, its String and its output slot are usually somewhere else in
+// memory, and a string table of an object file or a PDB may be far
+// bigger than the cache. The batch loop prefetches them this many
+// symbols ahead.
+const size_t batch_prefetch_distance = 8;
+
+// Asks for the first bytes of s to be loaded into the cache. Most
+// symbols fit in two cache lines.
+inline void prefetch_symbol(String s) {
+  MS_DEMANGLE_PREFETCH(s.p, 0);
+  if (s.len > 64)
+    MS_DEMANGLE_PREFETCH(s.p + 64, 0);
+}
+
+// Demangles in[0..n) on the pool and the calling thread. out[i] is set to
+// the result for in[i], or to an empty string if in[i] couldn't be
+// demangled. If errors isn't null, errors[i] is set to the error for
+// in[i], or cleared. Empty strings are skipped without an error, so
+// callers can blank out entries they don't want demangled. Results
+// longer than max_len fail as in demangle(). pages selects the memory
+// of the workers' arenas. prefetch is the distance in symbols at which
+// inputs are prefetched, or 0 for none. This function can be called
+// from multiple threads at once.
+inline void demangle_batch(const String *in, size_t n, std::string *out,
+                           ThreadPool &pool, PtrModel model = PtrAuto,
+                           Error *errors = nullptr,
+                           size_t max_len = SIZE_MAX,
+                           HugePages pages = HugePagesOff,
+                           size_t prefetch = batch_prefetch_distance) {
+  BatchPlan plan = plan_batch(in, n);
+  run_tasks(plan.num_tasks(), pool, [&](size_t t) {
+    ArenaRegion region = worker_arena_region(pages);
+    size_t end = plan.tasks[t + 1];
+    for (size_t j = plan.tasks[t]; j < end; ++j) {
+      // The String and the output slot are fetched twice as far ahead
+      // as the symbol, so that the String is there when the symbol's
+      // address is read from it.
+      if (prefetch) {
+        if (j + prefetch * 2 < end) {
+          uint32_t k = plan.order[j + prefetch * 2];
+          MS_DEMANGLE_PREFETCH(&in[k], 0);
+          MS_DEMANGLE_PREFETCH(&out[k], 1);
+        }
+        if (j + prefetch < end)
+          prefetch_symbol(in[plan.order[j + prefetch]]);
+      }
+
+      uint32_t i = plan.order[j];
+      Error err;
+      out[i].clear();
+      if (!in[i].empty() &&
+          !demangle(in[i], out[i], &err, model, max_len, region))
+        out[i].clear();
+      if (errors)
+        errors[i] = err;
+    }
+  });
+}
+
+// Splitting input into lines is the first step of every batch job. At
+// a few dozen bytes per symbol, calling memchr() once per line costs
+// as much as the search itself, so the SIMD versions below compare a
+// block of 32 bytes at a time and walk the resulting bit mask instead.
+
+// Appends a line ending at buf[end] ("\r\n" or "\n") to lines.
+inline void push_line(String buf, size_t begin, size_t end,
+                      std::vector<String> &lines) {
+  size_t len = end - begin;
+  if (len > 0 && buf.p[end - 1] == '\r')
+    --len;
+  lines.push_back(String(buf.p + begin, len));
+}
+
+inline size_t split_lines_scalar(String buf, std::vector<String> &lines,
+                                 size_t max, bool eof) {
+  size_t pos = 0;
+  while (pos < buf.len && lines.size() < max) {
+    const char *nl = (const char *)memchr(buf.p + pos, '\n', buf.len - pos);
+    if (!nl && !eof)
+      break;
+    size_t end = nl ? nl - buf.p : buf.len;
+    push_line(buf, pos, end, lines);
+    pos = nl ? end + 1 : end;
+  }
+  return pos;
+}
+
+// The common part of the SIMD versions. Mask::get(p) returns a bit mask
+// of the '\n' bytes in p[0..32).
+template <typename Mask>
+inline size_t split_lines_blocks(String buf, std::vector<String> &lines,
+                                 size_t max, bool eof) {
+  size_t pos = 0;
+  if (lines.size() >= max)
+    return pos;
+  for (size_t i = 0; i + 32 <= buf.len; i += 32) {
+    for (uint32_t m = Mask::get(buf.p + i); m; m &= m - 1) {
+      size_t end = i + ctz64(m);
+      push_line(buf, pos, end, lines);
+      pos = end + 1;
+      if (lines.size() == max)
+        return pos;
+    }
+  }
+  // There is no '\n' between pos and the last full block, so the rest
+  // is short.
+  return pos + split_lines_scalar(buf.substr(pos), lines, max, eof);
+}
+
+#ifdef MS_DEMANGLE_HAVE_SIMD
+struct Sse2Mask {
+  __attribute__((target("sse2"))) static uint32_t get(const char *p) {
+    __m128i nl = _mm_set1_epi8('\n');
+    __m128i a = _mm_loadu_si128((const __m128i *)p);
+    __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(a, nl)) |
+           (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(b, nl)) << 16;
+  }
+};
+
+struct Avx2Mask {
+  __attribute__((target("avx2"))) static uint32_t get(const char *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+  }
+};
+
+// flatten inlines Mask::get() into the loop, which is only allowed in a
+// function compiled for the same instruction set.
+__attribute__((target("sse2"), flatten)) inline size_t
+split_lines_sse2(String buf, std::vector<String> &lines, size_t max,
+                 bool eof) {
+  return split_lines_blocks<Sse2Mask>(buf, lines, max, eof);
+}
+
+__attribute__((target("avx2"), flatten)) inline size_t
+split_lines_avx2(String buf, std::vector<String> &lines, size_t max,
+                 bool eof) {
+  return split_lines_blocks<Avx2Mask>(buf, lines, max, eof);
+}
+#endif
+
+enum SimdLevel { SimdNone, SimdSse2, SimdAvx2 };
+
+// Returns the best instruction set that the CPU supports.
+inline SimdLevel simd_level() {
+#ifdef MS_DEMANGLE_HAVE_SIMD
+  static const SimdLevel level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return SimdAvx2;
+    if (__builtin_cpu_supports("sse2"))
+      return SimdSse2;
+    return SimdNone;
+  }();
+  return level;
+#else
+  return SimdNone;
+#endif
+}
+
+// Appends the lines of buf to lines, up to max lines, and returns the
+// number of bytes they span including their terminators. "\r\n" is
+// accepted as a terminator too. The last line doesn't need a terminator
+// if eof is set; otherwise it's left for the next call.
+inline size_t split_lines(String buf, std::vector<String> &lines, size_t max,
+                          bool eof) {
+  switch (simd_level()) {
+#ifdef MS_DEMANGLE_HAVE_SIMD
+  case SimdAvx2:
+    return split_lines_avx2(buf, lines, max, eof);
+  case SimdSse2:
+    return split_lines_sse2(buf, lines, max, eof);
+#endif
+  default:
+    return split_lines_scalar(buf, lines, max, eof);
+  }
+}
+
+// Inputs that contain a byte that can't be part of a mangled symbol can
+// be rejected before they are parsed. The valid bytes are those of
+// identifiers, the '?', '@' and '$' that the grammar is made of, '<',
+// '>' and '-' in names such as <lambda_1> and <unnamed-tag>, and any
+// non-ASCII byte, since identifiers are stored as UTF-8.
+inline bool is_symbol_char(unsigned char c) {
+  return ('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') ||
+         ('a' <= c && c <= 'z') || c == '_' || c == '?' || c == '@' ||
+         c == '$' || c == '<' || c == '>' || c == '-' || c >= 0x80;
+}
+
+inline size_t find_invalid_char_scalar(String s) {
+  size_t i = 0;
+  while (i < s.len && is_symbol_char(s.p[i]))
+    ++i;
+  return i;
+}
+
+// The common part of the SIMD versions. Class::invalid(p) returns a bit
+// mask of the bytes in p[0..32) that fail is_symbol_char().
+template <typename Class> inline size_t find_invalid_char_blocks(String s) {
+  size_t i = 0;
+  for (; i + 32 <= s.len; i += 32)
+    if (uint32_t m = Class::invalid(s.p + i))
+      return i + ctz64(m);
+  if (i == s.len)
+    return i;
+
+  // The tail is checked as a whole block without reading past the end
+  // of s. If s is longer than a block, the last 32 bytes of s are
+  // loaded, and the bytes before the tail are shifted out.
+  size_t n = s.len - i;
+  uint32_t m;
+  if (i > 0) {
+    m = Class::invalid(s.p + s.len - 32) >> (32 - n);
+  } else {
+    // Most symbols are shorter than a block. They are copied into a
+    // zero-padded block with fixed-size copies, which may overlap.
+    char tail[32] = {};
+    if (n >= 16) {
+      memcpy(tail, s.p, 16);
+      memcpy(tail + n - 16, s.p + n - 16, 16);
+    } else if (n >= 8) {
+      memcpy(tail, s.p, 8);
+      memcpy(tail + n - 8, s.p + n - 8, 8);
+    } else if (n >= 4) {
+      memcpy(tail, s.p, 4);
+      memcpy(tail + n - 4, s.p + n - 4, 4);
+    } else {
+      for (size_t j = 0; j < n; ++j)
+        tail[j] = s.p[j];
+    }
+    m = Class::invalid(tail) & ((1U << n) - 1);
+  }
+  return m ? i + ctz64(m) : s.len;
+}
+
+#ifdef MS_DEMANGLE_HAVE_SIMD
+// Characters are classified with unsigned range checks, which SSE2 can
+// do with a subtraction and a minimum. Bytes with the high bit set are
+// valid, which movemask gives for free.
+struct Sse2Class {
+  __attribute__((target("sse2"))) static __m128i in_range(__m128i c, char lo,
+                                                          char hi) {
+    __m128i x = _mm_sub_epi8(c, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(hi - lo)), x);
+  }
+
+  __attribute__((target("sse2"))) static __m128i eq(__m128i c, char x) {
+    return _mm_cmpeq_epi8(c, _mm_set1_epi8(x));
+  }
+
+  __attribute__((target("sse2"))) static uint32_t invalid16(const char *p) {
+    __m128i c = _mm_loadu_si128((const __m128i *)p);
+    // '<' to 'Z' covers '<', '>', '?', '@' and 'A' to 'Z', but also '='.
+    __m128i ok = _mm_andnot_si128(eq(c, '='), in_range(c, '<', 'Z'));
+    ok = _mm_or_si128(ok, in_range(c, '0', '9'));
+    ok = _mm_or_si128(ok, in_range(c, 'a', 'z'));
+    ok = _mm_or_si128(ok, _mm_or_si128(eq(c, '_'), eq(c, '$')));
+    ok = _mm_or_si128(ok, eq(c, '-'));
+    return ~(_mm_movemask_epi8(ok) | _mm_movemask_epi8(c)) & 0xFFFF;
+  }
+
+  __attribute__((target("sse2"))) static uint32_t invalid(const char *p) {
+    return invalid16(p) | invalid16(p + 16) << 16;
+  }
+};
+
+struct Avx2Class {
+  __attribute__((target("avx2"))) static __m256i in_range(__m256i c, char lo,
+                                                          char hi) {
+    __m256i x = _mm256_sub_epi8(c, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(hi - lo)),
+                             x);
+  }
+
+  __attribute__((target("avx2"))) static __m256i eq(__m256i c, char x) {
+    return _mm256_cmpeq_epi8(c, _mm256_set1_epi8(x));
+  }
+
+  __attribute__((target("avx2"))) static uint32_t invalid(const char *p) {
+    __m256i c = _mm256_loadu_si256((const __m256i *)p);
+    __m256i ok = _mm256_andnot_si256(eq(c, '='), in_range(c, '<', 'Z'));
+    ok = _mm256_or_si256(ok, in_range(c, '0', '9'));
+    ok = _mm256_or_si256(ok, in_range(c, 'a', 'z'));
+    ok = _mm256_or_si256(ok, _mm256_or_si256(eq(c, '_'), eq(c, '$')));
+    ok = _mm256_or_si256(ok, eq(c, '-'));
+    return ~((uint32_t)_mm256_movemask_epi8(ok) |
+             (uint32_t)_mm256_movemask_epi8(c));
+  }
+};
+
+__attribute__((target("sse2"), flatten)) inline size_t
+find_invalid_char_sse2(String s) {
+  return find_invalid_char_blocks<Sse2Class>(s);
+}
+
+__attribute__((target("avx2"), flatten)) inline size_t
+find_invalid_char_avx2(String s) {
+  return find_invalid_char_blocks<Avx2Class>(s);
+}
+#endif
+
+// Returns the index of the first byte of s that can't appear in a
+// mangled symbol, or s.len if there is none.
+inline size_t find_invalid_char(String s) {
+  switch (simd_level()) {
+#ifdef MS_DEMANGLE_HAVE_SIMD
+  case SimdAvx2:
+    return find_invalid_char_avx2(s);
+  case SimdSse2:
+    return find_invalid_char_sse2(s);
+#endif
+  default:
+    return find_invalid_char_scalar(s);
+  }
+}
+
+} // namespace ms_demangle
+
+#endif
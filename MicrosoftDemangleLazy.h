@@ -0,0 +1,150 @@
+//===- MicrosoftDemangleLazy.h ----------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines LazySymbolTable, a table of mangled symbols that are
+// demangled when they are first looked up. Programs such as profilers
+// load far more symbols than they ever show, so building the table only
+// costs as much as storing the string views.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MICROSOFT_DEMANGLE_LAZY_H
+#define MICROSOFT_DEMANGLE_LAZY_H
+
+#include "MicrosoftDemangle.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace ms_demangle {
+
+class LazySymbolTable {
+public:
+  // The table refers to the given strings, which must outlive it.
+  LazySymbolTable(const String *symbols, size_t n, PtrModel model = PtrAuto)
+      : entries(new Entry[n]), n(n), model(model) {
+    for (size_t i = 0; i < n; ++i)
+      entries[i].mangled = symbols[i];
+  }
+
+  LazySymbolTable(const LazySymbolTable &) = delete;
+  LazySymbolTable &operator=(const LazySymbolTable &) = delete;
+
+  size_t size() const { return n; }
+
+  String mangled(size_t i) const { return entries[i].mangled; }
+
+  // Returns the demangled form of symbol i, or the mangled symbol if it
+  // can't be demangled. The result is valid as long as the table.
+  //
+  // This can be called from multiple threads at once. The first caller
+  // for a symbol demangles it, and other callers for the same symbol
+  // wait for it rather than demangling it again. If demangling throws
+  // (e.g. std::bad_alloc), the exception goes to that caller, and the
+  // symbol is left to be demangled by the next one.
+  String get(size_t i) {
+    Entry &e = entries[i];
+    for (;;) {
+      uint8_t state = e.state.load(std::memory_order_acquire);
+      if (state == Done)
+        return e.result;
+
+      if (state == Pending &&
+          e.state.compare_exchange_strong(state, Busy,
+                                          std::memory_order_acquire)) {
+        try {
+          e.result = demangle_entry(e.mangled);
+        } catch (...) {
+          e.state.store(Pending, std::memory_order_release);
+          wake(i);
+          throw;
+        }
+        e.state.store(Done, std::memory_order_release);
+        wake(i);
+        return e.result;
+      }
+
+      std::unique_lock<std::mutex> lock(stripe_mu[i % num_stripes]);
+      stripe_cv[i % num_stripes].wait(lock, [&] {
+        return e.state.load(std::memory_order_acquire) != Busy;
+      });
+    }
+  }
+
+  // Returns the number of bytes used for demangled names.
+  size_t memory_usage() const {
+    std::lock_guard<std::mutex> lock(mu);
+    return used;
+  }
+
+private:
+  enum : uint8_t { Pending, Busy, Done };
+
+  struct Entry {
+    String mangled;
+    String result;
+    std::atomic<uint8_t> state{Pending};
+  };
+
+  // Wakes the callers waiting for symbol i. Taking the lock makes sure
+  // that a waiter either sees the new state or is already waiting.
+  void wake(size_t i) {
+    { std::lock_guard<std::mutex> lock(stripe_mu[i % num_stripes]); }
+    stripe_cv[i % num_stripes].notify_all();
+  }
+
+  String demangle_entry(String s) {
+    std::string out;
+    if (!demangle(s, out, nullptr, model))
+      return s;
+    return store(out);
+  }
+
+  // Copies s to storage that lives as long as the table. Names are
+  // packed into chunks instead of being allocated one by one.
+  String store(const std::string &s) {
+    std::lock_guard<std::mutex> lock(mu);
+    used += s.size();
+    if (s.size() > chunk_size / 4) {
+      chunks.emplace_back(new char[s.size()]);
+      memcpy(chunks.back().get(), s.data(), s.size());
+      return String(chunks.back().get(), s.size());
+    }
+    if (!cur || chunk_used + s.size() > chunk_size) {
+      chunks.emplace_back(new char[chunk_size]);
+      cur = chunks.back().get();
+      chunk_used = 0;
+    }
+    char *p = cur + chunk_used;
+    memcpy(p, s.data(), s.size());
+    chunk_used += s.size();
+    return String(p, s.size());
+  }
+
+  static const size_t num_stripes = 16;
+  static const size_t chunk_size = 1 << 16;
+
+  std::unique_ptr<Entry[]> entries;
+  size_t n;
+  PtrModel model;
+
+  std::mutex stripe_mu[num_stripes];
+  std::condition_variable stripe_cv[num_stripes];
+
+  mutable std::mutex mu;
+  std::vector<std::unique_ptr<char[]>> chunks;
+  char *cur = nullptr;
+  size_t chunk_used = 0;
+  size_t used = 0;
+};
+
+} // namespace ms_demangle
+
+#endif
@@ -0,0 +1,95 @@
+//===- bench/arena.cpp ----------------------------------------------------===//
+//
+// Compares demangle_batch() with each kind of worker arena memory:
+// the default stack buffer and heap chunks, a transparent huge page, and
+// an explicit huge page. Half of the symbols have parse trees too big
+// for the stack buffer, so that the default takes chunks from the heap.
+//
+//   arena [file]
+//
+// Symbols are read from the file, one per line, or a built-in set of
+// symbols is used. Besides the time, it prints the dTLB load misses and
+// page faults of the run, and how much of the process is backed by
+// transparent huge pages.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleBatch.h"
+#include "counters.h"
+#include "symbols.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+using namespace ms_demangle;
+
+// Returns a function taking n parameters of distinct template classes.
+static std::string big_symbol(int n) {
+  std::string s = "?f@@YAX";
+  for (int i = 0; i < n; ++i)
+    s += "PEAV?$k" + std::to_string(i) + "@PEAV?$v@H@@@@";
+  return s + "@Z";
+}
+
+// Returns AnonHugePages of this process in KiB.
+static std::string anon_huge_pages() {
+  std::ifstream in("/proc/self/smaps_rollup");
+  for (std::string line; std::getline(in, line);)
+    if (line.compare(0, 14, "AnonHugePages:") == 0)
+      return std::to_string(atol(line.c_str() + 14)) + " KiB";
+  return "n/a";
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> strings;
+  if (argc > 1) {
+    std::ifstream in(argv[1]);
+    for (std::string line; std::getline(in, line);)
+      strings.push_back(line);
+  } else {
+    std::string big = big_symbol(40);
+    for (size_t i = 0; i < 100000; ++i)
+      strings.push_back(i % 2 ? big : builtin_symbols[i / 2 % num_valid_symbols]);
+  }
+  std::vector<String> symbols(strings.begin(), strings.end());
+
+  static const char *const names[] = {"off", "thp", "explicit"};
+  std::vector<std::string> expected;
+  printf("pages     ms/round  dTLB misses  page faults  AnonHugePages\n");
+  for (HugePages pages :
+       {HugePagesOff, HugePagesTransparent, HugePagesExplicit}) {
+    const int rounds = 3;
+    std::vector<std::string> out(symbols.size());
+    Counter tlb = Counter::dtlb_load_misses();
+    Counter faults = Counter::page_faults();
+
+    double ms;
+    std::string huge;
+    {
+      // A new pool for each mode, so that its workers map new regions
+      // and are counted.
+      ThreadPool pool;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < rounds; ++i)
+        demangle_batch(symbols.data(), symbols.size(), out.data(), pool,
+                       PtrAuto, nullptr, SIZE_MAX, pages);
+      auto end = std::chrono::steady_clock::now();
+      ms = std::chrono::duration<double, std::milli>(end - start).count();
+      huge = anon_huge_pages();
+    }
+
+    printf("%-8s  %8.1f  %11s  %11s  %13s\n", names[pages], ms / rounds,
+           tlb.str().c_str(), faults.str().c_str(),
+           huge.c_str());
+    if (pages == HugePagesExplicit && !WorkerArena(pages).is_explicit())
+      printf("(no explicit huge pages are reserved, so thp was used)\n");
+    if (expected.empty())
+      expected = out;
+    else if (out != expected) {
+      printf("results differ\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,134 @@
+//===- bench/async.cpp ----------------------------------------------------===//
+//
+// Measures AsyncDemangler as a service would use it: several producer
+// threads submit symbols and collect whatever results are ready in
+// between. It prints the time producers spend in submit() and poll(),
+// which should stay far below the cost of demangling, the latency from
+// submission to result, and the throughput. Every result is checked
+// against demangle().
+//
+//   async [producers] [workers]
+//
+// The defaults are 4 producers and one worker per core.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleAsync.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace ms_demangle;
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_between(Clock::time_point a, Clock::time_point b) {
+  return std::chrono::duration<double, std::nano>(b - a).count();
+}
+
+int main(int argc, char **argv) {
+  unsigned producers = argc > 1 ? atoi(argv[1]) : 4;
+  unsigned workers =
+      argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+  const size_t per_producer = 200000;
+  const size_t total = per_producer * producers;
+
+  std::vector<String> symbols;
+  for (size_t i = 0; i < total; ++i)
+    symbols.push_back(builtin_symbols[i % num_builtin_symbols]);
+
+  // What each producer submitted and collected. Results are collected by
+  // whichever producer polls first, so they are matched up afterwards.
+  struct Sent {
+    uint64_t ticket;
+    size_t index;
+    Clock::time_point time;
+  };
+  struct Done {
+    AsyncResult result;
+    Clock::time_point time;
+  };
+  std::vector<std::vector<Sent>> sent(producers);
+  std::vector<std::vector<Done>> done(producers);
+  std::vector<double> submit_ns(producers), poll_ns(producers);
+
+  AsyncDemangler async(workers);
+  std::atomic<size_t> collected(0);
+  auto start = Clock::now();
+
+  std::vector<std::thread> threads;
+  for (unsigned p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      auto take = [&] {
+        AsyncResult r;
+        auto t0 = Clock::now();
+        bool got = async.poll(r);
+        auto t1 = Clock::now();
+        poll_ns[p] += ns_between(t0, t1);
+        if (got) {
+          done[p].push_back({std::move(r), t1});
+          ++collected;
+        }
+        return got;
+      };
+
+      for (size_t i = p * per_producer; i < (p + 1) * per_producer; ++i) {
+        auto t0 = Clock::now();
+        uint64_t ticket;
+        while (!(ticket = async.try_submit(symbols[i])))
+          take();
+        auto t1 = Clock::now();
+        submit_ns[p] += ns_between(t0, t1);
+        sent[p].push_back({ticket, i, t1});
+        take();
+      }
+      while (collected.load() < total)
+        if (!take())
+          std::this_thread::yield();
+    });
+  }
+  for (std::thread &t : threads)
+    t.join();
+  double ms = ns_between(start, Clock::now()) / 1e6;
+
+  std::vector<const Sent *> by_ticket(total + 1);
+  for (auto &v : sent)
+    for (const Sent &s : v)
+      by_ticket[s.ticket] = &s;
+
+  std::vector<double> latency;
+  size_t mismatches = 0;
+  for (auto &v : done) {
+    for (const Done &d : v) {
+      const Sent *s = by_ticket[d.result.ticket];
+      latency.push_back(ns_between(s->time, d.time) / 1000);
+      std::string expected;
+      bool ok = demangle(symbols[s->index], expected);
+      if (ok != d.result.ok() || expected != d.result.result)
+        ++mismatches;
+    }
+  }
+  std::sort(latency.begin(), latency.end());
+
+  double in_submit = 0, in_poll = 0;
+  for (unsigned p = 0; p < producers; ++p) {
+    in_submit += submit_ns[p];
+    in_poll += poll_ns[p];
+  }
+  printf("%u producers, %u workers: %.1f ms for %zu symbols (%.0f/s)\n",
+         producers, workers, ms, total, total / ms * 1000);
+  printf("submit %.0f ns, poll %.0f ns on average\n", in_submit / total,
+         in_poll / total);
+  printf("latency p50 %.1f us  p99 %.1f us  max %.1f us\n",
+         latency[latency.size() / 2], latency[latency.size() * 99 / 100],
+         latency.back());
+
+  if (latency.size() != total || mismatches) {
+    printf("%zu results, %zu mismatches\n", latency.size(), mismatches);
+    return 1;
+  }
+  return 0;
+}
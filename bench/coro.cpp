@@ -0,0 +1,169 @@
+//===- bench/coro.cpp -----------------------------------------------------===//
+//
+// Measures how long a reactor thread is held up by demangling. A single
+// reactor thread runs coroutines that each demangle a symbol, and a few
+// of the symbols are deeply nested templates that take milliseconds to
+// parse. It compares calling demangle() on the reactor with awaiting
+// co_demangle(), which parses on the workers of an AsyncDemangler, and
+// prints the longest step of the reactor loop for each. Steps are timed
+// in CPU time of the reactor thread, so that time slices given to the
+// workers on a machine with few cores don't count. It also reads all
+// results through a DemangleStream and checks their order.
+//
+//   coro
+//
+// This needs C++20 coroutines.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleAsync.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+
+using namespace ms_demangle;
+
+typedef std::chrono::steady_clock Clock;
+
+static std::string nested(int depth) {
+  std::string s;
+  for (int i = 0; i < depth; ++i)
+    s += "V?$a@";
+  s += "H";
+  for (int i = 0; i < depth; ++i)
+    s += "@@";
+  return "?x@@3" + s + "A";
+}
+
+static double thread_cpu_ms() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// A coroutine that starts right away and frees itself when it ends.
+struct Task {
+  struct promise_type {
+    Task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Runs coroutines one step at a time on the thread that calls run().
+class Reactor {
+public:
+  // co_await schedule() moves a coroutine to the reactor thread.
+  auto schedule() {
+    struct Awaitable {
+      Reactor &r;
+      bool await_ready() { return false; }
+      void await_suspend(std::coroutine_handle<> h) {
+        std::lock_guard<std::mutex> lock(r.mu);
+        r.ready.push_back(h);
+      }
+      void await_resume() {}
+    };
+    return Awaitable{*this};
+  }
+
+  // Runs until done is zero, and returns the longest step in ms.
+  double run(const std::atomic<size_t> &done) {
+    double longest = 0;
+    while (done.load()) {
+      std::coroutine_handle<> h;
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        if (!ready.empty()) {
+          h = ready.front();
+          ready.pop_front();
+        }
+      }
+      if (!h) {
+        std::this_thread::yield();
+        continue;
+      }
+      double start = thread_cpu_ms();
+      h.resume();
+      longest = std::max(longest, thread_cpu_ms() - start);
+    }
+    return longest;
+  }
+
+private:
+  std::mutex mu;
+  std::deque<std::coroutine_handle<>> ready;
+};
+
+static Task demangle_inline(Reactor &r, String s, std::string &out,
+                            std::atomic<size_t> &left) {
+  co_await r.schedule();
+  demangle(s, out);
+  --left;
+}
+
+static Task demangle_async(Reactor &r, AsyncDemangler &async, String s,
+                           std::string &out, std::atomic<size_t> &left) {
+  co_await r.schedule();
+  AsyncResult res = co_await co_demangle(async, s);
+  co_await r.schedule();
+  out = std::move(res.result);
+  --left;
+}
+
+static Task read_stream(AsyncDemangler &async, const std::vector<String> &in,
+                        std::vector<std::string> &out,
+                        std::atomic<size_t> &left) {
+  DemangleStream stream(async, in.data(), in.size());
+  while (std::optional<AsyncResult> r = co_await stream.next())
+    out.push_back(std::move(r->result));
+  --left;
+}
+
+int main() {
+  std::vector<std::string> strings;
+  std::string slow = nested(3000);
+  for (size_t i = 0; i < 20000; ++i)
+    strings.push_back(i % 2000 == 0 ? slow : builtin_symbols[i % num_valid_symbols]);
+  std::vector<String> symbols(strings.begin(), strings.end());
+  size_t n = symbols.size();
+
+  auto start = Clock::now();
+  std::string tmp;
+  demangle(String(slow), tmp);
+  printf("the slow symbol takes %.1f ms\n",
+         std::chrono::duration<double, std::milli>(Clock::now() - start)
+             .count());
+
+  Reactor reactor;
+  std::vector<std::string> expected(n);
+  std::atomic<size_t> left(n);
+  for (size_t i = 0; i < n; ++i)
+    demangle_inline(reactor, symbols[i], expected[i], left);
+  printf("demangle():     longest reactor step %.2f ms\n", reactor.run(left));
+
+  AsyncDemangler async;
+  std::vector<std::string> out(n);
+  left = n;
+  for (size_t i = 0; i < n; ++i)
+    demangle_async(reactor, async, symbols[i], out[i], left);
+  printf("co_demangle():  longest reactor step %.2f ms\n", reactor.run(left));
+
+  std::vector<std::string> streamed;
+  left = 1;
+  read_stream(async, symbols, streamed, left);
+  while (left.load())
+    std::this_thread::yield();
+
+  if (out != expected || streamed != expected) {
+    printf("results differ\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+//===- bench/counters.h -----------------------------------------*- C++ -*-===//
+//
+// Hardware and software event counters for the benchmarks, read with
+// perf_event_open(). A counter covers the thread that opens it and the
+// threads it starts afterwards, so a ThreadPool has to be created after
+// its counters. Counters the kernel or the CPU doesn't provide, as in
+// most VMs, read as "n/a".
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef BENCH_COUNTERS_H
+#define BENCH_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+class Counter {
+public:
+  Counter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~Counter() {
+    if (fd >= 0)
+      close(fd);
+  }
+
+  Counter(const Counter &) = delete;
+  Counter &operator=(const Counter &) = delete;
+
+  // Returns the count so far, or "n/a".
+  std::string str() const {
+    uint64_t n;
+    if (fd < 0 || read(fd, &n, sizeof(n)) != sizeof(n))
+      return "n/a";
+    return std::to_string(n);
+  }
+
+  static Counter dtlb_load_misses() {
+    return Counter(PERF_TYPE_HW_CACHE,
+                   PERF_COUNT_HW_CACHE_DTLB |
+                       PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                       PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+
+  static Counter l1d_load_misses() {
+    return Counter(PERF_TYPE_HW_CACHE,
+                   PERF_COUNT_HW_CACHE_L1D |
+                       PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                       PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+
+  static Counter cache_misses() {
+    return Counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  }
+
+  static Counter page_faults() {
+    return Counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+  }
+
+private:
+  int fd;
+};
+
+#endif
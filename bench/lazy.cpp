@@ -0,0 +1,85 @@
+//===- bench/lazy.cpp -----------------------------------------------------===//
+//
+// Compares loading a symbol table eagerly with demangle_batch() against
+// loading it into a LazySymbolTable and looking up a few thousand
+// entries, as a profiler does. The lookups run on several threads that
+// touch the same entries, and the results are checked against
+// demangle().
+//
+//   lazy [file]
+//
+// Symbols are read from the file, one per line, or a built-in set of
+// symbols is used.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleBatch.h"
+#include "../MicrosoftDemangleLazy.h"
+#include "symbols.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+using namespace ms_demangle;
+
+static double since(std::chrono::steady_clock::time_point start) {
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> strings;
+  if (argc > 1) {
+    std::ifstream in(argv[1]);
+    for (std::string line; std::getline(in, line);)
+      strings.push_back(line);
+  } else {
+    for (size_t i = 0; i < 500000; ++i)
+      strings.push_back(builtin_symbols[i % num_valid_symbols]);
+  }
+  std::vector<String> symbols(strings.begin(), strings.end());
+
+  ThreadPool pool;
+  std::vector<std::string> out(symbols.size());
+  auto start = std::chrono::steady_clock::now();
+  demangle_batch(symbols.data(), symbols.size(), out.data(), pool);
+  printf("eager: %.1f ms for %zu symbols\n", since(start), symbols.size());
+
+  // Each thread looks up the same 5000 entries in a different order.
+  std::vector<size_t> picks;
+  std::mt19937 rng(1);
+  for (int i = 0; i < 5000; ++i)
+    picks.push_back(rng() % symbols.size());
+
+  start = std::chrono::steady_clock::now();
+  LazySymbolTable table(symbols.data(), symbols.size());
+  double load = since(start);
+
+  std::vector<std::thread> threads;
+  std::atomic<size_t> mismatches(0);
+  for (unsigned t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      std::vector<size_t> order = picks;
+      std::shuffle(order.begin(), order.end(), std::mt19937(t));
+      for (size_t i : order) {
+        String s = table.get(i);
+        if (!(s == (out[i].empty() ? symbols[i] : String(out[i]))))
+          ++mismatches;
+      }
+    });
+  }
+  for (std::thread &t : threads)
+    t.join();
+  printf("lazy: %.1f ms to load, %.1f ms in total for %zu lookups"
+         " on %zu threads (%zu bytes of names)\n",
+         load, since(start), picks.size(), threads.size(),
+         table.memory_usage());
+
+  if (mismatches) {
+    printf("%zu mismatches\n", mismatches.load());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+//===- bench/number.cpp ---------------------------------------------------===//
+//
+// Measures how fast numbers of each width, from 1 to 16 hex digits, are
+// demangled. Each symbol is a pointer to an array with 16 dimensions of
+// random sizes. Printing the sizes takes much of that time, so it also
+// times decode_hex_number() on just the numbers, and the one character
+// at a time loop that read_number() used before it.
+//
+//   number
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace ms_demangle;
+
+// The old loop, which stops at the first character that isn't a digit.
+static uint64_t scalar_number(const char *p, size_t len) {
+  uint64_t ret = 0;
+  for (size_t i = 0; i < len; ++i) {
+    char c = p[i];
+    if (c == '@')
+      return ret;
+    if (c < 'A' || 'P' < c)
+      break;
+    ret = (ret << 4) + (c - 'A');
+  }
+  return ~0ULL;
+}
+
+// Returns the fastest of several runs of fn, in nanoseconds.
+template <class Fn> static double best(Fn fn) {
+  double ret = 1e300;
+  for (int i = 0; i < 5; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    ret = std::min(ret, std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  return ret;
+}
+
+int main() {
+  std::mt19937_64 rng(1);
+  const int count = 5000;
+  const int dims = 16;
+
+  printf("ns per number\n");
+  printf("digits  demangle    decode    scalar\n");
+  for (int width = 1; width <= 16; ++width) {
+    // The numbers are decoded from one buffer, so like in a symbol there
+    // are more characters after each of them.
+    std::string nums;
+    std::vector<size_t> starts;
+    std::vector<std::string> symbols;
+    for (int i = 0; i < count; ++i) {
+      std::string sym = "?x@@3PEAYBA@";
+      for (int k = 0; k < dims; ++k) {
+        std::string num;
+        uint64_t v = rng();
+        for (int j = 0; j < width; ++j)
+          num += (char)('A' + (v >> (j * 4) & 15));
+        // A leading zero digit is allowed but never emitted.
+        if (num[0] == 'A')
+          num[0] = 'B';
+        num += '@';
+        starts.push_back(nums.size());
+        nums += num;
+        sym += num;
+      }
+      symbols.push_back(sym + "HEA");
+    }
+
+    std::string out;
+    size_t ok = 0;
+    double demangle_ns = best([&] {
+      ok = 0;
+      for (const std::string &s : symbols) {
+        out.clear();
+        if (demangle(String(s), out))
+          ++ok;
+      }
+    });
+
+    uint64_t sum = 0;
+    double decode_ns = best([&] {
+      sum = 0;
+      for (size_t start : starts) {
+        uint64_t v = 0;
+        // Keep the compiler from hoisting the loop out.
+        asm volatile("" : : "r"(start) : "memory");
+        if (decode_hex_number(String(nums).substr(start), v))
+          sum += v;
+      }
+    });
+
+    uint64_t scalar_sum = 0;
+    double scalar_ns = best([&] {
+      scalar_sum = 0;
+      for (size_t start : starts) {
+        asm volatile("" : : "r"(start) : "memory");
+        scalar_sum += scalar_number(nums.data() + start, nums.size() - start);
+      }
+    });
+
+    double n = (double)starts.size();
+    printf("%6d  %8.1f  %8.1f  %8.1f\n", width, demangle_ns / n,
+           decode_ns / n, scalar_ns / n);
+    if (ok != symbols.size() || sum != scalar_sum) {
+      printf("results differ\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+//===- bench/prefetch.cpp -------------------------------------------------===//
+//
+// Measures how the prefetch distance of demangle_batch() affects a batch
+// whose symbols are scattered across a string table much bigger than
+// the cache, as in the symbol table of a large object file or a PDB.
+// The symbols are placed at random offsets in a 256 MiB table, and the
+// batch refers to them in random order.
+//
+//   prefetch [distance...]
+//
+// The default is to try distances from 0 (no prefetching) to 64. Cache
+// misses are read with the counters in counters.h, which are "n/a" where
+// the CPU doesn't provide them.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleBatch.h"
+#include "counters.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace ms_demangle;
+
+int main(int argc, char **argv) {
+  std::vector<size_t> distances;
+  for (int i = 1; i < argc; ++i)
+    distances.push_back(atol(argv[i]));
+  if (distances.empty())
+    distances = {0, 1, 2, 4, 8, 16, 32, 64};
+
+  // Each symbol gets its own 256-byte slot at a random place in the
+  // table, so no two symbols share a cache line.
+  const size_t table_size = 256 << 20;
+  const size_t slot = 256;
+  const size_t n = 1 << 20;
+  std::vector<char> table(table_size);
+  std::vector<size_t> slots(table_size / slot);
+  for (size_t i = 0; i < slots.size(); ++i)
+    slots[i] = i;
+  std::mt19937_64 rng(1);
+  std::shuffle(slots.begin(), slots.end(), rng);
+
+  std::vector<String> symbols;
+  for (size_t i = 0; i < n; ++i) {
+    const char *s = builtin_symbols[rng() % num_valid_symbols];
+    char *p = table.data() + slots[i] * slot;
+    memcpy(p, s, strlen(s));
+    symbols.push_back(String(p, strlen(s)));
+  }
+
+  std::vector<std::string> expected;
+  printf("distance  ms/round  L1D misses  cache misses\n");
+  for (size_t distance : distances) {
+    const int rounds = 3;
+    std::vector<std::string> out(n);
+    Counter l1d = Counter::l1d_load_misses();
+    Counter misses = Counter::cache_misses();
+
+    double best = 1e300;
+    {
+      ThreadPool pool;
+      for (int i = 0; i < rounds; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        demangle_batch(symbols.data(), n, out.data(), pool, PtrAuto, nullptr,
+                       SIZE_MAX, HugePagesOff, distance);
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(
+            best, std::chrono::duration<double, std::milli>(end - start).count());
+      }
+    }
+
+    printf("%8zu  %8.1f  %10s  %12s\n", distance, best, l1d.str().c_str(),
+           misses.str().c_str());
+    if (expected.empty())
+      expected = out;
+    else if (out != expected) {
+      printf("results differ\n");
+      return 1;
+    }
+  }
+  return 0;
+}
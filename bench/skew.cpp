@@ -0,0 +1,82 @@
+//===- bench/skew.cpp -----------------------------------------------------===//
+//
+// Measures the latency of demangle_batch() on a skewed batch: mostly
+// short symbols, with a run of deeply nested template symbols that are
+// each a few hundred times as expensive. It compares the cost-ordered
+// schedule of demangle_batch() with handing out the symbols in input
+// order, 64 at a time.
+//
+//   skew [threads]
+//
+// The default is one thread per core. The difference shows up only with
+// more than one core.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace ms_demangle;
+
+static std::string nested(int depth) {
+  if (depth == 0)
+    return "H";
+  return "V?$a@" + nested(depth - 1) + "@@";
+}
+
+// The scheduler demangle_batch() used before symbols were ordered by cost.
+static void demangle_chunked(const String *in, size_t n, std::string *out,
+                             ThreadPool &pool) {
+  const size_t chunk = 64;
+  run_tasks((n + chunk - 1) / chunk, pool, [&](size_t t) {
+    for (size_t i = t * chunk; i < std::min(t * chunk + chunk, n); ++i) {
+      out[i].clear();
+      if (!demangle(in[i], out[i]))
+        out[i].clear();
+    }
+  });
+}
+
+template <typename Fn>
+static void measure(const char *name, Fn fn) {
+  const int rounds = 200;
+  std::vector<double> us;
+  for (int i = 0; i < rounds; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  std::sort(us.begin(), us.end());
+  printf("%-8s p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name,
+         us[rounds / 2], us[rounds * 99 / 100], us.back());
+}
+
+int main(int argc, char **argv) {
+  unsigned threads =
+      argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+  ThreadPool pool(threads > 1 ? threads - 1 : 1);
+
+  // 8192 cheap symbols with 64 expensive ones in the middle, where they
+  // all land in one chunk.
+  std::vector<std::string> symbols(8192, "?x@ns@@3PEAV?$klass@HH@1@EA");
+  std::string heavy = "?x@@3" + nested(100) + "A";
+  for (size_t i = 4096; i < 4096 + 64; ++i)
+    symbols[i] = heavy;
+
+  std::vector<String> in(symbols.begin(), symbols.end());
+  std::vector<std::string> out(in.size());
+
+  printf("%u threads, %zu symbols\n", pool.size() + 1, in.size());
+  measure("chunked", [&] {
+    demangle_chunked(in.data(), in.size(), out.data(), pool);
+  });
+  measure("by cost", [&] {
+    demangle_batch(in.data(), in.size(), out.data(), pool);
+  });
+  return 0;
+}
@@ -0,0 +1,124 @@
+//===- bench/split.cpp ----------------------------------------------------===//
+//
+// Measures the speed of the line splitter that feeds demangle_batch()
+// and of the character check that rejects invalid input before it's
+// parsed, for each instruction set this CPU supports. It also checks
+// that all versions give the same results.
+//
+//   split [file]
+//
+// Lines are read from the file, or a built-in set of symbols is used.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleBatch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace ms_demangle;
+
+typedef size_t (*SplitFn)(String, std::vector<String> &, size_t, bool);
+
+static bool measure(const char *name, SplitFn fn, String data,
+                    std::vector<String> &expected) {
+  std::vector<String> lines;
+  lines.reserve(1 << 16);
+  const int rounds = 20;
+  size_t count = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    // Split in batches, as undname does.
+    for (size_t pos = 0; pos < data.len;) {
+      lines.clear();
+      pos += fn(data.substr(pos), lines, 1 << 16, true);
+      count += lines.size();
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  double s = std::chrono::duration<double>(end - start).count();
+  printf("%-7s %6.2f GB/s, %.2f ns/line\n", name,
+         data.len * rounds / s / 1e9, s * 1e9 / count);
+
+  lines.clear();
+  fn(data, lines, SIZE_MAX, true);
+  if (expected.empty())
+    expected = lines;
+  return lines.size() == expected.size() &&
+         std::equal(lines.begin(), lines.end(), expected.begin(),
+                    [](String a, String b) { return a.p == b.p && a == b; });
+}
+
+typedef size_t (*ClassifyFn)(String);
+
+// Checks each line, as undname --validate does, and returns the number
+// of lines with a byte that can't be in a symbol.
+static size_t measure_classify(const char *name, ClassifyFn fn,
+                               const std::vector<String> &lines) {
+  const int rounds = 20;
+  size_t bytes = 0;
+  size_t count = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    count = 0;
+    for (String line : lines) {
+      count += fn(line) < line.len;
+      bytes += line.len;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  double s = std::chrono::duration<double>(end - start).count();
+  printf("%-7s %6.2f GB/s, %.2f ns/line\n", name, bytes / s / 1e9,
+         s * 1e9 / (lines.size() * rounds));
+  return count;
+}
+
+int main(int argc, char **argv) {
+  std::string data;
+  if (argc > 1) {
+    std::ifstream in(argv[1]);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    data = ss.str();
+  } else {
+    const char *symbols[] = {
+        "?x@@3HA\n",
+        "?x@ns@@3PEAV?$klass@HH@1@EA\n",
+        "?f@@YAXV?$vector@HV?$allocator@H@std@@@std@@@Z\r\n",
+        "\n",
+    };
+    for (size_t i = 0; data.size() < (64 << 20); ++i)
+      data += symbols[i % 4];
+  }
+
+  printf("split_lines:\n");
+  std::vector<String> expected;
+  bool ok = measure("scalar", split_lines_scalar, data, expected);
+#ifdef MS_DEMANGLE_HAVE_SIMD
+  if (simd_level() >= SimdSse2)
+    ok &= measure("sse2", split_lines_sse2, data, expected);
+  if (simd_level() >= SimdAvx2)
+    ok &= measure("avx2", split_lines_avx2, data, expected);
+#endif
+
+  printf("find_invalid_char:\n");
+  size_t invalid =
+      measure_classify("scalar", find_invalid_char_scalar, expected);
+#ifdef MS_DEMANGLE_HAVE_SIMD
+  if (simd_level() >= SimdSse2)
+    ok &= invalid ==
+          measure_classify("sse2", find_invalid_char_sse2, expected);
+  if (simd_level() >= SimdAvx2)
+    ok &= invalid ==
+          measure_classify("avx2", find_invalid_char_avx2, expected);
+#endif
+  if (!ok) {
+    printf("results differ\n");
+    return 1;
+  }
+  return 0;
+}
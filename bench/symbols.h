@@ -0,0 +1,38 @@
+//===- bench/symbols.h ------------------------------------------*- C++ -*-===//
+//
+// The built-in symbols that the benchmarks and the tests use when they
+// aren't given a file. They cover the common kinds of symbols: data,
+// functions, templates, operators and member pointers.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef BENCH_SYMBOLS_H
+#define BENCH_SYMBOLS_H
+
+#include <cstddef>
+
+// All but the last of these demangle. The last fails, so that error
+// paths can be mixed in.
+static const char *const builtin_symbols[] = {
+    "?x@@3HA",
+    "?x@@3PEAY02$$CBHEA",
+    "?x@@3P6AHP6AHM@Z0@ZEA",
+    "?x@ns@@3PEAV?$klass@HH@1@EA",
+    "?fn@?$klass@H@ns@@QEBAIXZ",
+    "??4klass@@QEAAAEBV0@AEBV0@@Z",
+    "??6@YAAEBVklass@@AEBV0@H@Z",
+    "?f@@YAXV?$vector@HV?$allocator@H@std@@@std@@@Z",
+    "?x@@3P8klass@@EAAHH@ZEQ1@",
+    "??$f@$1?x@@3PEAHEA@@YAXXZ",
+    "?x@?A0xab@@YAXPEAVy@1@@Z",
+    "?x@@YAX_D_E_F_G_L_M@Z",
+    "?x@@3Z",
+};
+
+const size_t num_builtin_symbols =
+    sizeof(builtin_symbols) / sizeof(builtin_symbols[0]);
+
+// The number of symbols at the start of builtin_symbols that demangle.
+const size_t num_valid_symbols = num_builtin_symbols - 1;
+
+#endif
@@ -0,0 +1,53 @@
+//===- bench/throughput.cpp -----------------------------------------------===//
+//
+// Measures demangling throughput. The Makefile builds this twice: once
+// linked against the out-of-line library and once with
+// MS_DEMANGLE_HEADER_ONLY, so that the two can be compared.
+//
+//   throughput [file]
+//
+// Symbols are read from the file, one per line, or a built-in set of
+// symbols is used.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangle.h"
+#include "symbols.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+using namespace ms_demangle;
+
+int main(int argc, char **argv) {
+  std::vector<std::string> symbols;
+  if (argc > 1) {
+    std::ifstream in(argv[1]);
+    for (std::string line; std::getline(in, line);)
+      symbols.push_back(line);
+  } else {
+    for (size_t i = 0; i < num_valid_symbols; ++i)
+      symbols.push_back(builtin_symbols[i]);
+  }
+
+  const size_t total = 2000000;
+  size_t rounds = std::max<size_t>(1, total / symbols.size());
+  size_t bytes = 0;
+  std::string out;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i) {
+    for (const std::string &s : symbols) {
+      out.clear();
+      demangle(s, out);
+      bytes += out.size();
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  printf("%s: %.1f ns/symbol (%zu symbols, %zu bytes)\n", argv[0],
+         ns / (rounds * symbols.size()), rounds * symbols.size(), bytes);
+  return 0;
+}
@@ -0,0 +1,155 @@
+//===- python/ms_demangle.cpp ---------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A CPython extension module exposing the demangler.
+//
+//   import ms_demangle
+//   ms_demangle.demangle("?x@@3HA")              # => "int x"
+//   ms_demangle.demangle_batch(["?x@@3HA", ...]) # => ["int x", ...]
+//   ms_demangle.error_stats()                    # => {"ErrPrimType": 1, ...}
+//
+// demangle_batch() releases the GIL while it runs on a thread pool, so
+// large batches use all cores. Symbols that can't be demangled are
+// returned as None by demangle_batch() and raise ValueError in
+// demangle().
+//
+//===----------------------------------------------------------------------===//
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define MS_DEMANGLE_HEADER_ONLY
+#include "../MicrosoftDemangleBatch.h"
+
+#include <unistd.h>
+
+using namespace ms_demangle;
+
+// The pool is created on first use and lives as long as the process.
+// A child process made by fork() (e.g. by multiprocessing) inherits the
+// pool but none of its threads, so it gets a new pool. The inherited one
+// is leaked, as its threads can't be joined and its lock may have been
+// held by one of them at the time of the fork. Call this with the GIL
+// held.
+static ThreadPool &get_pool() {
+  static ThreadPool *pool;
+  static pid_t owner;
+  if (!pool || owner != getpid()) {
+    pool = new ThreadPool;
+    owner = getpid();
+  }
+  return *pool;
+}
+
+static PyObject *py_demangle(PyObject *self, PyObject *arg) {
+  Py_ssize_t len;
+  const char *p = PyUnicode_AsUTF8AndSize(arg, &len);
+  if (!p)
+    return nullptr;
+
+  std::string out;
+  Error err;
+  if (!demangle(String(p, len), out, &err)) {
+    PyErr_SetString(PyExc_ValueError, err.str().c_str());
+    return nullptr;
+  }
+  return PyUnicode_FromStringAndSize(out.data(), out.size());
+}
+
+static PyObject *py_demangle_batch(PyObject *self, PyObject *arg) {
+  PyObject *seq = PySequence_Fast(arg, "demangle_batch() expects a sequence");
+  if (!seq)
+    return nullptr;
+
+  // Keep references to the items while the GIL is released, because
+  // another thread may modify the list in the meantime.
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+  std::vector<PyObject *> items(n);
+  std::vector<String> in(n);
+  for (Py_ssize_t i = 0; i < n; ++i) {
+    items[i] = PySequence_Fast_GET_ITEM(seq, i);
+    Py_ssize_t len;
+    const char *p = PyUnicode_AsUTF8AndSize(items[i], &len);
+    if (!p) {
+      Py_DECREF(seq);
+      return nullptr;
+    }
+    Py_INCREF(items[i]);
+    in[i] = String(p, len);
+  }
+  Py_DECREF(seq);
+
+  std::vector<std::string> out(n);
+  ThreadPool &pool = get_pool();
+  Py_BEGIN_ALLOW_THREADS
+  demangle_batch(in.data(), n, out.data(), pool);
+  Py_END_ALLOW_THREADS
+
+  for (PyObject *item : items)
+    Py_DECREF(item);
+
+  PyObject *ret = PyList_New(n);
+  if (!ret)
+    return nullptr;
+  for (Py_ssize_t i = 0; i < n; ++i) {
+    PyObject *s;
+    if (out[i].empty()) {
+      Py_INCREF(Py_None);
+      s = Py_None;
+    } else {
+      s = PyUnicode_FromStringAndSize(out[i].data(), out[i].size());
+      if (!s) {
+        Py_DECREF(ret);
+        return nullptr;
+      }
+    }
+    PyList_SET_ITEM(ret, i, s);
+  }
+  return ret;
+}
+
+static PyObject *py_error_stats(PyObject *self, PyObject *) {
+  ErrorStats stats = error_stats();
+  PyObject *ret = PyDict_New();
+  if (!ret)
+    return nullptr;
+  for (size_t i = 1; i < NumErrorCodes; ++i) {
+    PyObject *n = PyLong_FromUnsignedLongLong(stats.count[i]);
+    if (!n || PyDict_SetItemString(ret, error_name((ErrorCode)i), n) < 0) {
+      Py_XDECREF(n);
+      Py_DECREF(ret);
+      return nullptr;
+    }
+    Py_DECREF(n);
+  }
+  return ret;
+}
+
+static PyMethodDef methods[] = {
+    {"demangle", py_demangle, METH_O,
+     "demangle(symbol: str) -> str\n\n"
+     "Demangles an MSVC-style mangled symbol. Raises ValueError if the\n"
+     "symbol can't be demangled."},
+    {"demangle_batch", py_demangle_batch, METH_O,
+     "demangle_batch(symbols: list[str]) -> list[str | None]\n\n"
+     "Demangles symbols in parallel without holding the GIL. Symbols that\n"
+     "can't be demangled are returned as None."},
+    {"error_stats", py_error_stats, METH_NOARGS,
+     "error_stats() -> dict[str, int]\n\n"
+     "Returns the number of symbols that failed with each error code so\n"
+     "far, on all threads."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+static PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "ms_demangle",
+    "Demangler for MSVC-style mangled symbols.", -1, methods,
+};
+
+PyMODINIT_FUNC PyInit_ms_demangle() { return PyModule_Create(&module); }
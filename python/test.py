@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Tests for the ms_demangle extension module. Run "make test-python".
+
+import ms_demangle
+
+def expect(actual, expected):
+    assert actual == expected, f"{expected!r} expected, but got {actual!r}"
+
+expect(ms_demangle.demangle('?x@@3HA'), 'int x')
+expect(ms_demangle.demangle('?x@ns@@3PEAV?$klass@HH@1@EA'),
+       'class ns::klass<int,int>*ns::x')
+
+try:
+    ms_demangle.demangle('?x@@3')
+    raise AssertionError('ValueError expected')
+except ValueError as e:
+    expect(str(e), 'unknown primitive type: ')
+
+expect(ms_demangle.demangle_batch([]), [])
+expect(ms_demangle.demangle_batch(['?x@@3HA', '?x@@3', '?x@@3PEAHEA']),
+       ['int x', None, 'int*x'])
+
+# Large enough to be split across threads.
+syms = ['?x@@3HA', '??0klass@@QEAA@XZ'] * 5000
+expect(ms_demangle.demangle_batch(syms),
+       ['int x', 'klass::klass(void)'] * 5000)
+expect(ms_demangle.demangle_batch(tuple(syms[:2])), ['int x', 'klass::klass(void)'])
+
+# Failures above: one from demangle() and one from demangle_batch().
+stats = ms_demangle.error_stats()
+expect(stats['ErrPrimType'], 2)
+expect(sum(stats.values()), 2)
+ms_demangle.demangle_batch(['?x@@3Z'] * 5000)
+expect(ms_demangle.error_stats()['ErrPrimType'], 5002)
+
+# A child process made by fork() has none of the pool's threads.
+import os
+pid = os.fork()
+if pid == 0:
+    ok = ms_demangle.demangle_batch(syms) == ['int x', 'klass::klass(void)'] * 5000
+    os._exit(0 if ok else 1)
+_, status = os.waitpid(pid, 0)
+expect(os.waitstatus_to_exitcode(status), 0)
+
+print('OK')
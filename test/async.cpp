@@ -0,0 +1,152 @@
+//===- test/async.cpp -----------------------------------------------------===//
+//
+// Tests AsyncDemangler. Several producers submit distinct symbols and
+// poll for results, and every ticket must come back exactly once with
+// the result of its own symbol. Then post() is called far beyond the
+// capacity without taking anything, and every callback must run once.
+// Last, the demangler is destroyed while posts are set aside, and their
+// callbacks must still run.
+//
+//   async
+//
+// It exits with 1 and a message on failure, and is killed by an alarm
+// if it hangs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleAsync.h"
+#include "check.h"
+
+#include <unistd.h>
+
+using namespace ms_demangle;
+
+// Symbol i demangles to "int v<i>", except that every 16th is invalid.
+struct Symbols {
+  explicit Symbols(size_t n) : strings(n) {
+    for (size_t i = 0; i < n; ++i) {
+      strings[i] = "?v" + std::to_string(i) + (i % 16 ? "@@3HA" : "@@3Z");
+      symbols.push_back(strings[i]);
+    }
+  }
+
+  bool matches(size_t i, const AsyncResult &r) const {
+    if (i % 16 == 0)
+      return !r.ok() && r.result.empty() && r.error.code == ErrPrimType;
+    return r.ok() && r.result == "int v" + std::to_string(i);
+  }
+
+  std::vector<std::string> strings;
+  std::vector<String> symbols;
+};
+
+// Counts callbacks for post().
+struct Posted {
+  const Symbols *symbols;
+  size_t index;
+  std::atomic<int> calls{0};
+  std::atomic<bool> ok{false};
+};
+
+static void posted_done(void *ctx, AsyncResult &r) {
+  Posted *p = (Posted *)ctx;
+  p->ok = p->symbols->matches(p->index, r);
+  ++p->calls;
+}
+
+int main() {
+  alarm(60);
+
+  // Every ticket comes back once, with its own symbol's result.
+  {
+    const size_t producers = 4, per_producer = 5000;
+    const size_t total = producers * per_producer;
+    Symbols syms(total);
+    // Results are matched up with their symbols after the run, since a
+    // result may be taken before its producer has recorded the ticket.
+    std::vector<size_t> index_of(total + 1);
+    std::vector<AsyncResult> result_of(total + 1);
+    std::vector<std::atomic<int>> seen(total + 1);
+    std::atomic<size_t> collected(0);
+    std::atomic<size_t> bad(0);
+
+    AsyncDemangler async(2, 64);
+    auto take = [&] {
+      AsyncResult r;
+      if (!async.poll(r))
+        return false;
+      if (r.ticket == 0 || r.ticket > total || seen[r.ticket]++)
+        ++bad;
+      else
+        result_of[r.ticket] = std::move(r);
+      ++collected;
+      return true;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+      threads.emplace_back([&, p] {
+        for (size_t i = p * per_producer; i < (p + 1) * per_producer; ++i) {
+          uint64_t ticket;
+          while (!(ticket = async.try_submit(syms.symbols[i])))
+            take();
+          if (ticket > total)
+            ++bad;
+          else
+            index_of[ticket] = i;
+        }
+        while (collected.load() < total)
+          if (!take())
+            std::this_thread::yield();
+      });
+    }
+    for (std::thread &t : threads)
+      t.join();
+    CHECK(collected == total, "wrong number of results");
+    CHECK(bad == 0, "bad or repeated ticket");
+    for (size_t t = 1; t <= total; ++t)
+      CHECK(seen[t] == 1 && syms.matches(index_of[t], result_of[t]),
+            "ticket missing or with the wrong result");
+  }
+
+  // post() never fails or waits, even far beyond the capacity.
+  {
+    Symbols syms(5000);
+    std::vector<Posted> posted(syms.symbols.size());
+    {
+      AsyncDemangler async(2, 8);
+      for (size_t i = 0; i < posted.size(); ++i) {
+        posted[i].symbols = &syms;
+        posted[i].index = i;
+        async.post(syms.symbols[i], posted_done, &posted[i]);
+      }
+      for (Posted &p : posted)
+        while (p.calls.load() == 0)
+          std::this_thread::yield();
+    }
+    for (Posted &p : posted)
+      CHECK(p.calls == 1 && p.ok, "wrong callback for post()");
+  }
+
+  // Two results that are never taken fill the demangler, so the posts
+  // are set aside until it is destroyed.
+  {
+    Symbols syms(100);
+    std::vector<Posted> posted(syms.symbols.size());
+    {
+      AsyncDemangler async(1, 2);
+      CHECK(async.try_submit(syms.symbols[1]) &&
+                async.try_submit(syms.symbols[2]),
+            "try_submit failed");
+      CHECK(!async.try_submit(syms.symbols[3]), "try_submit beyond capacity");
+      for (size_t i = 0; i < posted.size(); ++i) {
+        posted[i].symbols = &syms;
+        posted[i].index = i;
+        async.post(syms.symbols[i], posted_done, &posted[i]);
+      }
+    }
+    for (Posted &p : posted)
+      CHECK(p.calls == 1 && p.ok, "post() dropped by ~AsyncDemangler");
+  }
+  return 0;
+}
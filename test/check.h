@@ -0,0 +1,23 @@
+//===- test/check.h ---------------------------------------------*- C++ -*-===//
+//
+// The assertion that the library tests use. Unlike assert(), it is kept
+// in NDEBUG builds.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+
+// Prints the file, the line and msg, and exits with 1, if ok is false.
+#define CHECK(ok, msg)                                                         \
+  do {                                                                         \
+    if (!(ok)) {                                                               \
+      printf("%s:%d: %s\n", __FILE__, __LINE__, msg);                          \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+#endif
@@ -0,0 +1,117 @@
+//===- test/coro.cpp ------------------------------------------------------===//
+//
+// Tests the coroutine interface of AsyncDemangler. A DemangleStream is
+// read to the end and then left after a few results, on a demangler with
+// a single worker, where the reader runs on that worker. Then coroutines
+// are suspended in co_demangle() with their symbols set aside by post()
+// when the demangler is destroyed, and must all be resumed.
+//
+//   coro
+//
+// It exits with 1 and a message on failure, and is killed by an alarm
+// if it hangs. This needs C++20 coroutines.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleAsync.h"
+#include "../bench/symbols.h"
+#include "check.h"
+
+#include <unistd.h>
+
+using namespace ms_demangle;
+
+// A coroutine that starts right away and frees itself when it ends.
+struct Task {
+  struct promise_type {
+    Task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+static void wait_for(const std::atomic<size_t> &left) {
+  while (left.load())
+    std::this_thread::yield();
+}
+
+// Reads up to limit results, and leaves the stream while symbols are
+// still in flight if limit is less than the number of symbols.
+static Task read_stream(AsyncDemangler &async, const std::vector<String> &in,
+                        size_t limit, std::vector<std::string> &out,
+                        std::atomic<size_t> &left) {
+  {
+    DemangleStream stream(async, in.data(), in.size(), 16);
+    while (out.size() < limit) {
+      std::optional<AsyncResult> r = co_await stream.next();
+      if (!r)
+        break;
+      out.push_back(std::move(r->result));
+    }
+  }
+  --left;
+}
+
+static Task demangle_one(AsyncDemangler &async, String s, std::string &out,
+                         std::atomic<size_t> &left) {
+  AsyncResult r = co_await co_demangle(async, s);
+  out = std::move(r.result);
+  --left;
+}
+
+int main() {
+  alarm(60);
+
+  std::vector<String> symbols;
+  std::vector<std::string> expected;
+  for (size_t i = 0; i < 1000; ++i) {
+    symbols.push_back(builtin_symbols[i % num_builtin_symbols]);
+    std::string out;
+    demangle(symbols.back(), out);
+    expected.push_back(out);
+  }
+
+  for (unsigned threads : {1, 4}) {
+    AsyncDemangler async(threads);
+    std::atomic<size_t> left(1);
+
+    // Read to the end.
+    std::vector<std::string> out;
+    read_stream(async, symbols, SIZE_MAX, out, left);
+    wait_for(left);
+    CHECK(out == expected, "stream results differ");
+
+    // Leave after three results. With one worker, the reader leaves on
+    // the worker while the rest of the window is queued behind it.
+    out.clear();
+    left = 1;
+    read_stream(async, symbols, 3, out, left);
+    wait_for(left);
+    CHECK(out == std::vector<std::string>(expected.begin(),
+                                          expected.begin() + 3),
+          "results before leaving the stream differ");
+
+    // The demangler still works afterwards.
+    AsyncResult r;
+    CHECK(async.try_submit(symbols[1]) != 0, "try_submit failed");
+    async.wait(r);
+    CHECK(r.result == expected[1], "result after leaving the stream differs");
+  }
+
+  // Two symbols whose results are never taken fill the demangler, so
+  // the coroutines' symbols are set aside until it is destroyed.
+  std::vector<std::string> out(symbols.size());
+  std::atomic<size_t> left(symbols.size());
+  {
+    AsyncDemangler async(1, 2);
+    CHECK(async.try_submit(symbols[0]) && async.try_submit(symbols[0]),
+          "try_submit failed");
+    for (size_t i = 0; i < symbols.size(); ++i)
+      demangle_one(async, symbols[i], out[i], left);
+  }
+  CHECK(left == 0, "coroutines left suspended by ~AsyncDemangler");
+  CHECK(out == expected, "co_demangle results differ");
+  return 0;
+}
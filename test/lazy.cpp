@@ -0,0 +1,111 @@
+//===- test/lazy.cpp ------------------------------------------------------===//
+//
+// Tests LazySymbolTable. Several threads look up the same entries for
+// the first time at once, and every result must match demangle(). Then
+// the first lookup of an entry throws std::bad_alloc while other threads
+// are waiting for it, and they must get the result rather than hang.
+//
+//   lazy
+//
+// It exits with 1 and a message on failure, and is killed by an alarm
+// if it hangs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../MicrosoftDemangleLazy.h"
+#include "../bench/symbols.h"
+#include "check.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace ms_demangle;
+
+// Allocations on a thread with fail_alloc set throw, after a pause that
+// lets other threads start waiting. in_alloc tells when that has begun.
+static thread_local bool fail_alloc = false;
+static std::atomic<bool> in_alloc(false);
+
+void *operator new(size_t n) {
+  if (fail_alloc) {
+    in_alloc = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    throw std::bad_alloc();
+  }
+  if (void *p = malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main() {
+  alarm(60);
+
+  std::vector<String> symbols;
+  for (size_t i = 0; i < 7000; ++i)
+    symbols.push_back(builtin_symbols[i % num_builtin_symbols]);
+  std::vector<std::string> expected;
+  for (String s : symbols) {
+    std::string out;
+    expected.push_back(demangle(s, out) ? out : s.str());
+  }
+
+  // Concurrent first touch. Each thread walks the table from a
+  // different place, so threads meet on entries that are being
+  // demangled.
+  {
+    LazySymbolTable table(symbols.data(), symbols.size());
+    std::vector<std::thread> threads;
+    std::atomic<size_t> mismatches(0);
+    for (size_t t = 0; t < 8; ++t) {
+      threads.emplace_back([&, t] {
+        for (size_t j = 0; j < symbols.size(); ++j) {
+          size_t i = (j + t * 997) % symbols.size();
+          if (!(table.get(i) == String(expected[i])))
+            ++mismatches;
+        }
+      });
+    }
+    for (std::thread &t : threads)
+      t.join();
+    CHECK(mismatches == 0, "wrong result on first touch");
+  }
+
+  // The first lookup throws while others wait.
+  {
+    LazySymbolTable table(symbols.data(), symbols.size());
+    bool threw = false;
+    std::thread first([&] {
+      fail_alloc = true;
+      try {
+        table.get(4);
+      } catch (const std::bad_alloc &) {
+        threw = true;
+      }
+      fail_alloc = false;
+    });
+    while (!in_alloc)
+      std::this_thread::yield();
+
+    std::vector<std::thread> waiters;
+    std::atomic<size_t> mismatches(0);
+    for (size_t t = 0; t < 4; ++t)
+      waiters.emplace_back([&] {
+        if (!(table.get(4) == String(expected[4])))
+          ++mismatches;
+      });
+    first.join();
+    for (std::thread &t : waiters)
+      t.join();
+    CHECK(threw, "bad_alloc didn't reach the caller");
+    CHECK(mismatches == 0, "wrong result after bad_alloc");
+    CHECK(table.get(4) == String(expected[4]), "entry lost after bad_alloc");
+  }
+  return 0;
+}
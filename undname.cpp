@@ -0,0 +1,1568 @@
+//===- undname.cpp --------------------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is dual licensed under the MIT and the University of Illinois Open
+// Source Licenses. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A command line tool to demangle MSVC-style mangled symbols.
+//
+//   undname [-m32|-m64] <symbol>
+//   undname [-m32|-m64] -f <file> [-o <file>] [--checkpoint <file>]
+//           [--checkpoint-every <n>] [--resume] [--format <format>]
+//           [--validate] [--errors <file>] [--stats]
+//           [--memory-limit <MiB>] [--huge-pages off|thp|explicit]
+//           [--shard <i>/<n>]
+//   undname merge [--sort] [-o <file>] <file>...
+//
+// The first form demangles one symbol. The second form demangles a file
+// with one symbol per line, in parallel, and writes one line per symbol.
+//
+// With --checkpoint, the input and output offsets are saved every n
+// symbols (default 1M) after the output is synced to disk. --resume
+// truncates the output to the saved offset and continues from there, so
+// an interrupted job only redoes the work since the last checkpoint.
+//
+// --format selects the layout of the input: "lines" has one symbol per
+// line, and "nm" and "dumpbin" are the text output of llvm-nm and of
+// dumpbin /symbols or /exports. Only the symbol column of those is
+// demangled; the rest of each line is kept. "text" is free text, such as
+// a log or a compiler message, in which every name that looks mangled
+// is demangled if possible and kept as is otherwise. The default,
+// "auto", guesses the format from the first lines.
+//
+// --validate writes nothing but a line for each symbol that can't be
+// demangled, and exits with 1 if there are any.
+//
+// By default, the first symbol that can't be demangled stops the job.
+// With --errors, it is written to the output as is, and a line
+// "<input offset>\t<error code>\t<position in symbol>\n" is written to
+// the given file ("-" for stderr) on another thread instead.
+//
+// --stats writes the number of failures for each error code to stderr
+// at the end, and the largest amount of memory each part of the job
+// used.
+//
+// --memory-limit keeps the memory used by a batch job under the given
+// size, however long the input runs. Symbols longer than 16 KiB or
+// with results longer than 64 KiB fail with ErrCapacity, and so do
+// lines too long for the budget, which are copied to the output as is.
+// In text mode such lines are copied without failing.
+//
+// --huge-pages backs the parse trees of each worker thread with a 2 MiB
+// transparent ("thp") or explicit ("explicit") huge page, which saves
+// TLB misses on long jobs. Explicit pages fall back to transparent ones
+// if none are reserved.
+//
+// --shard splits a job among n processes, on one machine or many, that
+// don't talk to each other. Each one reads the whole input but only
+// demangles the lines whose hash falls in shard i, and writes them to
+// the -o file. The input offset of each of those lines is written to
+// "<file>.idx", after a line "shard <i>/<n>". The hash depends only on
+// the bytes of a line, so every process agrees on it. Lines too long
+// for --memory-limit are not hashed and go to shard 0.
+//
+// "undname merge" puts the outputs of all n shards back together, in
+// input order, or sorted bytewise with --sort. Sorting takes one shard
+// at a time in memory, next to a temporary "<file>.sorted".
+//
+// The file can be "-" for stdin. Input compressed with gzip or zstd is
+// decompressed on the fly if undname was built with zlib or zstd.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MicrosoftDemangleBatch.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <queue>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef UNDNAME_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef UNDNAME_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace ms_demangle;
+
+// Writes s to a file descriptor. The CLI uses raw write(2) rather than
+// std::cout to keep process startup cheap. Returns false on an error.
+static bool try_write_fd(int fd, String s) {
+  while (s.len > 0) {
+    ssize_t n = write(fd, s.p, s.len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      if (n == 0)
+        errno = EIO;
+      return false;
+    }
+    s.trim(n);
+  }
+  return true;
+}
+
+[[noreturn]] static void die(const std::string &msg) {
+  try_write_fd(2, "undname: " + msg + "\n");
+  exit(1);
+}
+
+[[noreturn]] static void die_errno(const std::string &msg) {
+  die(msg + ": " + strerror(errno));
+}
+
+// Same as try_write_fd() but exits on an error, so that a batch job
+// never counts output as written, or checkpoints it, when it was lost
+// (e.g. to ENOSPC or EIO).
+static void write_fd(int fd, String s) {
+  if (!try_write_fd(fd, s))
+    die_errno("write failed");
+}
+
+// The layout of the input lines. See find_symbol().
+enum TextFormat {
+  FormatAuto,
+  FormatLines,
+  FormatNm,
+  FormatDumpbin,
+  FormatText,
+};
+
+struct Options {
+  PtrModel model = PtrAuto;
+  TextFormat format = FormatAuto;
+  const char *symbol = nullptr;
+  const char *input = nullptr;
+  const char *output = nullptr;
+  const char *checkpoint = nullptr;
+  bool resume = false;
+  bool validate = false;
+  const char *errors = nullptr;
+  bool stats = false;
+  // In bytes. Zero means no limit.
+  size_t memory_limit = 0;
+  HugePages huge_pages = HugePagesOff;
+  // With --shard, the shard of this process and the number of shards.
+  unsigned shard = 0;
+  unsigned shards = 0;
+  // Symbols demangled between checkpoints.
+  size_t checkpoint_every = 1 << 20;
+};
+
+// The progress of a batch job, written to the checkpoint file as
+// "<input offset> <output offset>\n". Both offsets are at line
+// boundaries. With --errors, the offset in the error log follows.
+struct Checkpoint {
+  uint64_t in = 0;
+  uint64_t out = 0;
+  uint64_t err = 0;
+};
+
+static Checkpoint read_checkpoint(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f)
+    die_errno(path);
+  Checkpoint c;
+  unsigned long long in, out, err = 0;
+  if (fscanf(f, "%llu %llu %llu", &in, &out, &err) < 2)
+    die(std::string(path) + ": malformed checkpoint");
+  fclose(f);
+  c.in = in;
+  c.out = out;
+  c.err = err;
+  return c;
+}
+
+// Replaces the checkpoint file atomically. The output must have been
+// synced before, so that the checkpoint never points past data that
+// isn't on disk.
+static void write_checkpoint(const char *path, Checkpoint c, bool with_err) {
+  std::string tmp = std::string(path) + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    die_errno(tmp);
+  char buf[96];
+  int len = snprintf(buf, sizeof(buf), "%llu %llu",
+                     (unsigned long long)c.in, (unsigned long long)c.out);
+  if (with_err)
+    len += snprintf(buf + len, sizeof(buf) - len, " %llu",
+                    (unsigned long long)c.err);
+  buf[len++] = '\n';
+  write_fd(fd, String(buf, len));
+  if (fsync(fd) < 0)
+    die_errno(tmp);
+  close(fd);
+  if (rename(tmp.c_str(), path) < 0)
+    die_errno(path);
+}
+
+// The largest amount of memory that each part of a batch job used,
+// for --stats. Parts are noted from more than one thread.
+struct MemoryStats {
+  enum Part { Input, LineBuffer, Block, ErrorQueue, NumParts };
+
+  void note(Part part, size_t bytes) {
+    size_t cur = peak[part].load(std::memory_order_relaxed);
+    while (bytes > cur &&
+           !peak[part].compare_exchange_weak(cur, bytes,
+                                             std::memory_order_relaxed))
+      ;
+  }
+
+  std::atomic<size_t> peak[NumParts] = {};
+};
+
+// How --memory-limit is divided among the parts of a batch job that
+// grow with the input. Without a limit, nothing is capped.
+struct MemoryBudget {
+  // Symbols longer than this aren't parsed, which caps the size of the
+  // parse tree each thread builds.
+  size_t max_symbol = SIZE_MAX;
+  // Results longer than this fail. A symbol can refer back to a long
+  // name many times, so its result can be far longer than itself.
+  size_t max_output = SIZE_MAX;
+  // The number of results in memory at once.
+  size_t max_results = SIZE_MAX;
+  // Lines longer than this aren't demangled, and blocks of lines are
+  // no longer than this.
+  size_t max_line = SIZE_MAX;
+  // The size of the error records waiting to be written.
+  size_t max_errors = SIZE_MAX;
+};
+
+// A source of input bytes. read() returns 0 at the end of input and
+// dies on errors.
+class Reader {
+public:
+  virtual ~Reader() = default;
+  virtual size_t read(char *buf, size_t n) = 0;
+};
+
+class FdReader : public Reader {
+public:
+  // prefix holds bytes that were already read from fd to detect the
+  // input format. They are returned first.
+  FdReader(int fd, const char *name, std::string prefix)
+      : fd(fd), name(name), prefix(std::move(prefix)) {}
+
+  size_t read(char *buf, size_t n) override {
+    if (prefix_pos < prefix.size()) {
+      n = std::min(n, prefix.size() - prefix_pos);
+      memcpy(buf, prefix.data() + prefix_pos, n);
+      prefix_pos += n;
+      return n;
+    }
+    for (;;) {
+      ssize_t r = ::read(fd, buf, n);
+      if (r >= 0)
+        return r;
+      if (errno != EINTR)
+        die_errno(name);
+    }
+  }
+
+private:
+  int fd;
+  const char *name;
+  std::string prefix;
+  size_t prefix_pos = 0;
+};
+
+#ifdef UNDNAME_HAVE_ZLIB
+class GzipReader : public Reader {
+public:
+  GzipReader(std::unique_ptr<Reader> in, const char *name)
+      : in(std::move(in)), name(name) {
+    // 15 + 32 selects the largest window and accepts gzip headers.
+    if (inflateInit2(&zs, 15 + 32) != Z_OK)
+      die(std::string(name) + ": inflateInit2 failed");
+  }
+
+  ~GzipReader() { inflateEnd(&zs); }
+
+  size_t read(char *buf, size_t n) override {
+    zs.next_out = (Bytef *)buf;
+    zs.avail_out = n;
+    while (zs.avail_out == n) {
+      if (zs.avail_in == 0) {
+        zs.next_in = (Bytef *)inbuf;
+        zs.avail_in = in->read(inbuf, sizeof(inbuf));
+        if (zs.avail_in == 0) {
+          if (!stream_end)
+            die(std::string(name) + ": unexpected end of gzip data");
+          return 0;
+        }
+      }
+
+      // A file may consist of several gzip members, which are
+      // decompressed one after another.
+      stream_end = false;
+      int r = inflate(&zs, Z_NO_FLUSH);
+      if (r == Z_STREAM_END) {
+        inflateReset(&zs);
+        stream_end = true;
+      } else if (r != Z_OK && r != Z_BUF_ERROR) {
+        die(std::string(name) + ": " + (zs.msg ? zs.msg : "bad gzip data"));
+      }
+    }
+    return n - zs.avail_out;
+  }
+
+private:
+  std::unique_ptr<Reader> in;
+  const char *name;
+  z_stream zs = {};
+  char inbuf[1 << 16];
+  bool stream_end = false;
+};
+#endif
+
+#ifdef UNDNAME_HAVE_ZSTD
+class ZstdReader : public Reader {
+public:
+  ZstdReader(std::unique_ptr<Reader> in, const char *name)
+      : in(std::move(in)), name(name), dctx(ZSTD_createDCtx()) {
+    if (!dctx)
+      die(std::string(name) + ": ZSTD_createDCtx failed");
+  }
+
+  ~ZstdReader() { ZSTD_freeDCtx(dctx); }
+
+  size_t read(char *buf, size_t n) override {
+    ZSTD_outBuffer out = {buf, n, 0};
+    while (out.pos == 0) {
+      if (src.pos == src.size) {
+        src.size = in->read(inbuf, sizeof(inbuf));
+        src.pos = 0;
+        if (src.size == 0) {
+          if (!frame_end)
+            die(std::string(name) + ": unexpected end of zstd data");
+          return 0;
+        }
+      }
+      size_t r = ZSTD_decompressStream(dctx, &out, &src);
+      if (ZSTD_isError(r))
+        die(std::string(name) + ": " + ZSTD_getErrorName(r));
+      frame_end = r == 0;
+    }
+    return out.pos;
+  }
+
+private:
+  std::unique_ptr<Reader> in;
+  const char *name;
+  ZSTD_DCtx *dctx;
+  char inbuf[1 << 16];
+  ZSTD_inBuffer src = {inbuf, 0, 0};
+  bool frame_end = false;
+};
+#endif
+
+enum Compression { Uncompressed, Gzip, Zstd };
+
+static Compression detect_compression(String magic) {
+  if (magic.startswith("\x1f\x8b"))
+    return Gzip;
+  if (magic.startswith("\x28\xb5\x2f\xfd"))
+    return Zstd;
+  return Uncompressed;
+}
+
+// Returns a reader for fd that decompresses the input if needed.
+static std::unique_ptr<Reader> make_reader(int fd, const char *name,
+                                           std::string prefix) {
+  Compression c = detect_compression(prefix);
+  std::unique_ptr<Reader> r(new FdReader(fd, name, std::move(prefix)));
+  if (c == Gzip) {
+#ifdef UNDNAME_HAVE_ZLIB
+    r.reset(new GzipReader(std::move(r), name));
+#else
+    die(std::string(name) + ": gzip input, but undname was built without zlib");
+#endif
+  } else if (c == Zstd) {
+#ifdef UNDNAME_HAVE_ZSTD
+    r.reset(new ZstdReader(std::move(r), name));
+#else
+    die(std::string(name) + ": zstd input, but undname was built without zstd");
+#endif
+  }
+  return r;
+}
+
+// A ring of blocks filled by a reader on its own thread and drained by
+// the main thread, so that reading and decompressing overlap with
+// demangling.
+class BlockRing {
+public:
+  explicit BlockRing(std::unique_ptr<Reader> r)
+      : reader(std::move(r)), thread([this] { fill(); }) {}
+
+  ~BlockRing() {
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      stop = true;
+    }
+    cv.notify_all();
+    thread.join();
+  }
+
+  // The memory used for blocks. The reader stops when all of them are
+  // full, so this is all the input that is read ahead.
+  static const size_t memory = (4 << 20);
+
+  // Returns the next block of input, or an empty string at the end of
+  // input. The block stays valid until the next call.
+  String next() {
+    std::unique_lock<std::mutex> lock(mu);
+    if (holding) {
+      ++tail;
+      holding = false;
+      cv.notify_all();
+    }
+    cv.wait(lock, [this] { return head != tail || eof; });
+    if (head == tail)
+      return {};
+    holding = true;
+    Block &b = blocks[tail % num_blocks];
+    return String(b.data.get(), b.len);
+  }
+
+private:
+  static const size_t num_blocks = 4;
+  static const size_t block_size = memory / num_blocks;
+
+  struct Block {
+    std::unique_ptr<char[]> data{new char[block_size]};
+    size_t len = 0;
+  };
+
+  void fill() {
+    for (bool done = false; !done;) {
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [this] { return head - tail < num_blocks || stop; });
+        if (stop)
+          return;
+      }
+
+      // Only this thread touches the block at head until it's published.
+      Block &b = blocks[head % num_blocks];
+      b.len = 0;
+      while (b.len < block_size) {
+        size_t n = reader->read(b.data.get() + b.len, block_size - b.len);
+        if (n == 0) {
+          done = true;
+          break;
+        }
+        b.len += n;
+      }
+
+      std::lock_guard<std::mutex> lock(mu);
+      if (b.len > 0)
+        ++head;
+      eof = done;
+      cv.notify_all();
+    }
+  }
+
+  std::unique_ptr<Reader> reader;
+  Block blocks[num_blocks];
+  size_t head = 0;
+  size_t tail = 0;
+  bool holding = false;
+  bool eof = false;
+  bool stop = false;
+  std::mutex mu;
+  std::condition_variable cv;
+  std::thread thread;
+};
+
+// Writes error records to a file on its own thread, so that a stretch
+// of bad input doesn't hold up the main output. A write error is
+// reported on the next call from the main thread, or at the end.
+class ErrorLog {
+public:
+  ErrorLog(int fd, const char *name, size_t max_queued, MemoryStats &mem)
+      : fd(fd), name(name), max_queued(max_queued), mem(mem),
+        thread([this] { drain(); }) {}
+
+  ~ErrorLog() {
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      stop = true;
+    }
+    cv.notify_all();
+    thread.join();
+    check();
+  }
+
+  // Queues records to be written and clears them. This doesn't wait
+  // for the write unless more than max_queued bytes are waiting, which
+  // happens only if the file is slower than the input.
+  void add(std::string &records) {
+    std::unique_lock<std::mutex> lock(mu);
+    cv.wait(lock, [&] {
+      return pending.empty() || pending.size() + records.size() <= max_queued;
+    });
+    check();
+    if (pending.empty())
+      pending.swap(records);
+    else
+      pending += records;
+    records.clear();
+    mem.note(MemoryStats::ErrorQueue, pending.capacity());
+    cv.notify_all();
+  }
+
+  // Waits until all queued records are written and synced to disk.
+  void sync() {
+    std::unique_lock<std::mutex> lock(mu);
+    cv.wait(lock, [this] { return pending.empty() && !writing; });
+    check();
+    // Pipes and terminals can't be synced.
+    if (fsync(fd) < 0 && errno != EINVAL)
+      die_errno(name);
+  }
+
+private:
+  void drain() {
+    std::string buf;
+    std::unique_lock<std::mutex> lock(mu);
+    for (;;) {
+      cv.wait(lock, [this] { return !pending.empty() || stop; });
+      if (pending.empty())
+        return;
+      buf.swap(pending);
+      writing = true;
+      lock.unlock();
+      bool ok = try_write_fd(fd, buf);
+      int e = errno;
+      buf.clear();
+      lock.lock();
+      if (!ok && !failed)
+        failed = e;
+      writing = false;
+      cv.notify_all();
+    }
+  }
+
+  int fd;
+  const char *name;
+  size_t max_queued;
+  MemoryStats &mem;
+  // Dies if a write has failed.
+  void check() {
+    if (failed) {
+      errno = failed;
+      die_errno(name);
+    }
+  }
+
+  std::string pending;
+  bool writing = false;
+  bool stop = false;
+  // The errno of the first failed write.
+  int failed = 0;
+  std::mutex mu;
+  std::condition_variable cv;
+  std::thread thread;
+};
+
+static bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+// Returns the field of s that starts at or after pos, where fields are
+// separated by spaces, and moves pos past it.
+static String next_field(String s, size_t &pos) {
+  while (pos < s.len && is_space(s.p[pos]))
+    ++pos;
+  size_t begin = pos;
+  while (pos < s.len && !is_space(s.p[pos]))
+    ++pos;
+  return s.substr(begin, pos - begin);
+}
+
+static bool all_of(String s, int (*pred)(int)) {
+  for (size_t i = 0; i < s.len; ++i)
+    if (!pred((unsigned char)s.p[i]))
+      return false;
+  return !s.empty();
+}
+
+// llvm-nm prints "[address [size]] type name", where the address is
+// blank for undefined symbols.
+static String find_nm_symbol(String line) {
+  String fields[5];
+  size_t n = 0;
+  for (size_t pos = 0; n < 5;) {
+    String f = next_field(line, pos);
+    if (f.empty())
+      break;
+    fields[n++] = f;
+  }
+  if (n < 2 || n == 5 || fields[n - 2].len != 1)
+    return {};
+  for (size_t i = 0; i + 2 < n; ++i)
+    if (!all_of(fields[i], isxdigit))
+      return {};
+  return fields[n - 1];
+}
+
+// "dumpbin /symbols" prints the name after a '|', and "dumpbin
+// /exports" prints "ordinal [hint] [RVA] name [= ...]". Other lines are
+// headers and summaries.
+static String find_dumpbin_symbol(String line) {
+  size_t pos = 0;
+  for (; pos < line.len; ++pos)
+    if (line.p[pos] == '|')
+      return next_field(line, ++pos);
+
+  pos = 0;
+  if (!all_of(next_field(line, pos), isdigit))
+    return {};
+  for (;;) {
+    String f = next_field(line, pos);
+    if (f.empty() || f.startswith('?') || !all_of(f, isxdigit))
+      return f;
+  }
+}
+
+// Appends the mangled names in free text. A name starts with '?' and
+// extends over the bytes that can appear in a symbol, so anything that
+// follows it, such as punctuation or quotes, is left alone.
+static void find_text_symbols(String line, std::vector<String> &symbols) {
+  for (size_t pos = 0; pos < line.len;) {
+    const char *q = (const char *)memchr(line.p + pos, '?', line.len - pos);
+    if (!q)
+      return;
+    String rest = line.substr(q - line.p);
+    size_t len = find_invalid_char(rest);
+    if (len > 1)
+      symbols.push_back(rest.substr(0, len));
+    pos = rest.p - line.p + std::max<size_t>(len, 1);
+  }
+}
+
+// Appends the parts of line to be demangled. The rest of the line is
+// copied to the output as is.
+static void find_symbols(TextFormat format, String line,
+                         std::vector<String> &symbols) {
+  String sym;
+  switch (format) {
+  case FormatNm:
+    sym = find_nm_symbol(line);
+    break;
+  case FormatDumpbin:
+    sym = find_dumpbin_symbol(line);
+    break;
+  case FormatText:
+    find_text_symbols(line, symbols);
+    return;
+  default:
+    sym = line;
+    break;
+  }
+  if (!sym.empty())
+    symbols.push_back(sym);
+}
+
+// Guesses the format of the input from its beginning.
+static TextFormat detect_format(String data) {
+  std::vector<String> lines;
+  split_lines(data.substr(0, std::min<size_t>(data.len, 4096)), lines, 32,
+              false);
+  for (String line : lines) {
+    size_t pos = 0;
+    String f = next_field(line, pos);
+    if (f == "Microsoft" || f == "Dump")
+      return FormatDumpbin;
+    if (!find_nm_symbol(line).empty())
+      return FormatNm;
+    // llvm-nm starts the symbols of each file with "<file>:".
+    if (!f.empty() && f.p[f.len - 1] != ':')
+      return FormatLines;
+  }
+  return FormatLines;
+}
+
+// Returns the shard of a line for --shard. The hash is FNV-1a, which
+// gives the same result on every machine.
+static unsigned shard_of(String line, unsigned shards) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < line.len; ++i)
+    h = (h ^ (unsigned char)line.p[i]) * 1099511628211ULL;
+  return h % shards;
+}
+
+// Demangles lines of input in blocks and writes the results to a file
+// descriptor, saving checkpoints as it goes. With --shard, the index of
+// the lines written goes to index_fd.
+class BatchWriter {
+public:
+  BatchWriter(const Options &opts, int fd, int index_fd, Checkpoint pos,
+              ErrorLog *log, const MemoryBudget &budget, MemoryStats &mem)
+      : opts(opts), format(opts.format), fd(fd), index_fd(index_fd),
+        pos(pos), log(log), budget(budget), mem(mem) {}
+
+  // Picks the format for --format auto from the beginning of the input.
+  // This is called before skipping to a checkpoint, because the header
+  // that identifies dumpbin output is only at the beginning.
+  void detect(String head) {
+    if (format == FormatAuto)
+      format = detect_format(head);
+  }
+
+  // Demangles the lines in data, which starts at input offset pos.in,
+  // and returns the number of bytes consumed.
+  size_t write(String data, bool eof) {
+    if (format == FormatAuto)
+      format = detect_format(data);
+
+    size_t off = 0;
+    for (;;) {
+      // A block is limited in bytes as well as in lines, so that the
+      // views into it stay within the memory budget.
+      String rest = data.substr(off);
+      String window = rest.substr(0, std::min(rest.len, budget.max_line));
+      lines.clear();
+      size_t consumed =
+          split_lines(window, lines, block, eof && window.len == rest.len);
+      if (lines.empty()) {
+        if (window.len == rest.len)
+          return off;
+        // The next line is longer than the budget allows.
+        const char *nl = (const char *)memchr(rest.p, '\n', rest.len);
+        if (!nl && !eof)
+          return off;
+        size_t n = nl ? nl - rest.p + 1 : rest.len;
+        pass_long_line(rest.substr(0, n), true);
+        off += n;
+        continue;
+      }
+
+      if (opts.shards) {
+        keep_shard_lines(rest);
+        if (lines.empty()) {
+          off += consumed;
+          pos.in += consumed;
+          continue;
+        }
+      }
+
+      // Symbols are views into the input, so nothing is copied until
+      // the output is assembled. Line i has the symbols from first[i]
+      // to first[i + 1].
+      symbols.clear();
+      first.clear();
+      for (String line : lines) {
+        first.push_back(symbols.size());
+        find_symbols(format, line, symbols);
+      }
+      first.push_back(symbols.size());
+
+      // Symbols with bytes that can't be in a symbol, when validating,
+      // and symbols longer than the budget allows are rejected without
+      // being parsed.
+      inputs.assign(symbols.begin(), symbols.end());
+      rejected.assign(symbols.size(), Error());
+      for (size_t i = 0; i < symbols.size(); ++i) {
+        Error &err = rejected[i];
+        if (opts.validate) {
+          size_t at = find_invalid_char(symbols[i]);
+          if (at < symbols[i].len) {
+            err.code = ErrBadChar;
+            err.input = symbols[i].substr(at);
+          }
+        }
+        if (err.empty() && symbols[i].len > budget.max_symbol) {
+          err.code = ErrCapacity;
+          err.input = symbols[i];
+        }
+        if (!err.empty()) {
+          inputs[i] = String();
+          ++num_rejected[err.code];
+        }
+      }
+
+      // Symbols are demangled a chunk at a time, and each chunk is
+      // written before the next one starts, so that only one chunk of
+      // results is in memory at once.
+      size_t line = 0;
+      const char *cur = lines[0].p;
+      auto finish_line = [&] {
+        if (!opts.validate) {
+          buf.append(cur, lines[line].p + lines[line].len);
+          buf += '\n';
+        }
+        if (++line < lines.size())
+          cur = lines[line].p;
+      };
+
+      size_t written = 0;
+      for (size_t start = 0; start < symbols.size();) {
+        size_t n = std::min(symbols.size() - start, budget.max_results);
+        results.resize(std::max(results.size(), n));
+        errors.resize(n);
+        demangle_batch(inputs.data() + start, n, results.data(), pool,
+                       opts.model, errors.data(), budget.max_output,
+                       opts.huge_pages);
+        note_block_memory(n);
+
+        for (size_t j = start; j < start + n; ++j) {
+          while (j >= first[line + 1])
+            finish_line();
+
+          String sym = symbols[j];
+          Error err = rejected[j].empty() ? errors[j - start] : rejected[j];
+          uint64_t at = pos.in + (sym.p - rest.p);
+          if (opts.validate) {
+            if (!err.empty()) {
+              buf += std::string(opts.input) + ":" + std::to_string(at) +
+                     ": " + err.str() + "\n";
+              ++failures;
+            }
+            continue;
+          }
+
+          buf.append(cur, sym.p);
+          cur = sym.p + sym.len;
+          if (err.empty()) {
+            buf += results[j - start];
+          } else if (format == FormatText) {
+            // Text may contain things that only look like symbols.
+            buf.append(sym.p, sym.len);
+          } else if (log) {
+            buf.append(sym.p, sym.len);
+            size_t where = err.input.p ? err.input.p - sym.p : sym.len;
+            records += std::to_string(at) + "\t" + error_name(err.code) +
+                       "\t" + std::to_string(where) + "\n";
+          } else {
+            write_fd(fd, buf);
+            die(std::string(opts.input) + ":" + std::to_string(at) + ": " +
+                err.str());
+          }
+        }
+        start += n;
+
+        if (buf.size() >= flush_size) {
+          write_fd(fd, buf);
+          written += buf.size();
+          buf.clear();
+        }
+      }
+      while (line < lines.size())
+        finish_line();
+
+      write_fd(fd, buf);
+      written += buf.size();
+      buf.clear();
+      if (opts.shards) {
+        write_fd(index_fd, index);
+        index.clear();
+      }
+      off += consumed;
+      pos.in += consumed;
+      pos.out += written;
+      add_records();
+
+      since_checkpoint += lines.size();
+      if (since_checkpoint >= opts.checkpoint_every)
+        checkpoint();
+    }
+  }
+
+  // Copies part of a line that is too long to demangle to the output
+  // as is. first is true for the part that starts the line.
+  void pass_long_line(String s, bool first) {
+    if (first) {
+      keep_long = !opts.shards || opts.shard == 0;
+      if (keep_long && opts.shards)
+        write_fd(index_fd, std::to_string(pos.in) + "\n");
+    }
+    if (first && keep_long) {
+      ++num_rejected[ErrCapacity];
+      std::string where = std::string(opts.input) + ":" +
+                          std::to_string(pos.in);
+      std::string msg =
+          "line longer than " + std::to_string(budget.max_line) + " bytes";
+      if (opts.validate) {
+        std::string line = where + ": " + msg + "\n";
+        write_fd(fd, line);
+        pos.out += line.size();
+        ++failures;
+      } else if (log) {
+        records += std::to_string(pos.in) + "\t" + error_name(ErrCapacity) +
+                   "\t0\n";
+        add_records();
+      } else if (format != FormatText) {
+        die(where + ": " + msg);
+      }
+    }
+    pos.in += s.len;
+    if (keep_long && !opts.validate) {
+      write_fd(fd, s);
+      pos.out += s.len;
+    }
+  }
+
+  // Returns the number of symbols that failed validation.
+  size_t num_failures() const { return failures; }
+
+  // Returns the number of symbols and lines rejected with each error
+  // code. They aren't counted by error_stats() because they are never
+  // parsed.
+  const size_t *rejected_counts() const { return num_rejected; }
+
+  // Saves a checkpoint if requested.
+  void checkpoint() {
+    if (!opts.checkpoint)
+      return;
+    if (fsync(fd) < 0)
+      die_errno(opts.output);
+    if (log)
+      log->sync();
+    write_checkpoint(opts.checkpoint, pos, log);
+    since_checkpoint = 0;
+  }
+
+private:
+  static const size_t block = 1 << 16;
+
+  // Output is written when this much of it is buffered.
+  static const size_t flush_size = 1 << 20;
+
+  // Drops the lines of other shards from lines, and adds the input
+  // offsets of the rest to the index. rest starts at pos.in.
+  void keep_shard_lines(String rest) {
+    size_t n = 0;
+    for (String line : lines) {
+      if (shard_of(line, opts.shards) != opts.shard)
+        continue;
+      index += std::to_string(pos.in + (line.p - rest.p));
+      index += '\n';
+      lines[n++] = line;
+    }
+    lines.resize(n);
+  }
+
+  void add_records() {
+    if (records.empty())
+      return;
+    pos.err += records.size();
+    log->add(records);
+  }
+
+  // Records the memory held for the current block.
+  void note_block_memory(size_t n) {
+    size_t bytes = buf.capacity() + records.capacity() + index.capacity() +
+                   lines.capacity() * sizeof(String) +
+                   symbols.capacity() * sizeof(String) +
+                   inputs.capacity() * sizeof(String) +
+                   first.capacity() * sizeof(size_t) +
+                   rejected.capacity() * sizeof(Error) +
+                   errors.capacity() * sizeof(Error) +
+                   results.capacity() * sizeof(std::string);
+    for (size_t i = 0; i < n; ++i)
+      bytes += results[i].capacity();
+    mem.note(MemoryStats::Block, bytes);
+  }
+
+  const Options &opts;
+  TextFormat format;
+  int fd;
+  int index_fd;
+  Checkpoint pos;
+  ErrorLog *log;
+  const MemoryBudget &budget;
+  MemoryStats &mem;
+  ThreadPool pool;
+  std::vector<String> lines;
+  std::vector<String> symbols;
+  std::vector<size_t> first;
+  std::vector<String> inputs;
+  std::vector<Error> rejected;
+  std::vector<std::string> results;
+  std::vector<Error> errors;
+  std::string buf;
+  std::string records;
+  std::string index;
+  // True while passing a long line that belongs to this shard.
+  bool keep_long = true;
+  size_t since_checkpoint = 0;
+  size_t failures = 0;
+  size_t num_rejected[NumErrorCodes] = {};
+};
+
+// Demangles a regular, uncompressed file by mapping it into memory.
+static void run_mmap(int fd, BatchWriter &w, Checkpoint pos,
+                     const Options &opts) {
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    die_errno(opts.input);
+  if ((uint64_t)st.st_size < pos.in)
+    die(std::string(opts.checkpoint) + ": input offset out of range");
+  if ((uint64_t)st.st_size == pos.in)
+    return;
+
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED)
+    die_errno(opts.input);
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  String data((const char *)p, st.st_size);
+  w.detect(data);
+  w.write(data.substr(pos.in), true);
+}
+
+// Demangles a pipe or a compressed file, reading it on another thread.
+static void run_stream(std::unique_ptr<Reader> r, BatchWriter &w,
+                       Checkpoint pos, const Options &opts,
+                       const MemoryBudget &budget, MemoryStats &mem) {
+  BlockRing ring(std::move(r));
+  mem.note(MemoryStats::Input, BlockRing::memory);
+  std::string buf;
+  uint64_t skip = pos.in;
+  // True while copying a line that is too long to buffer.
+  bool passing = false;
+  for (String b; !(b = ring.next()).empty();) {
+    if (pos.in == skip)
+      w.detect(b);
+
+    // On resume, the input before the checkpoint is read and dropped.
+    size_t n = std::min<uint64_t>(skip, b.len);
+    b.trim(n);
+    skip -= n;
+
+    if (passing) {
+      const char *nl = (const char *)memchr(b.p, '\n', b.len);
+      size_t len = nl ? nl - b.p + 1 : b.len;
+      w.pass_long_line(b.substr(0, len), false);
+      b.trim(len);
+      passing = !nl;
+    }
+
+    buf.append(b.p, b.len);
+    buf.erase(0, w.write(buf, false));
+    mem.note(MemoryStats::LineBuffer, buf.capacity());
+
+    // What is left is part of a line. If it's already too long, it is
+    // written out rather than kept.
+    if (buf.size() > budget.max_line) {
+      w.pass_long_line(buf, true);
+      buf.clear();
+      buf.shrink_to_fit();
+      passing = true;
+    }
+  }
+  if (skip)
+    die(std::string(opts.checkpoint) + ": input offset out of range");
+  w.write(buf, true);
+}
+
+// Writes the number of failures for each error code to stderr, and the
+// peak memory use.
+static void write_stats(const BatchWriter &w, const MemoryStats &mem) {
+  ErrorStats stats = error_stats();
+  for (size_t i = 0; i < NumErrorCodes; ++i)
+    stats.count[i] += w.rejected_counts()[i];
+  std::string buf;
+  for (size_t i = 1; i < NumErrorCodes; ++i)
+    if (stats.count[i])
+      buf += std::to_string(stats.count[i]) + "\t" +
+             error_name((ErrorCode)i) + "\n";
+  buf += std::to_string(stats.total()) + "\ttotal\n";
+
+  static const char *const parts[] = {"input", "line buffer", "block",
+                                      "error queue"};
+  for (size_t i = 0; i < MemoryStats::NumParts; ++i)
+    buf += std::to_string(mem.peak[i].load()) + "\tbytes peak " +
+           parts[i] + "\n";
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0)
+    buf += std::to_string((uint64_t)ru.ru_maxrss * 1024) +
+           "\tbytes max rss\n";
+  write_fd(2, buf);
+}
+
+// Divides --memory-limit among the parts of a job with the given
+// number of threads.
+static MemoryBudget plan_memory(size_t limit, size_t threads) {
+  MemoryBudget b;
+  if (!limit)
+    return b;
+
+  // A parse tree has at most about two nodes of 64 bytes per character
+  // of the symbol. Output buffers grow by doubling.
+  b.max_symbol = 16 << 10;
+  b.max_output = 64 << 10;
+  size_t per_thread = b.max_symbol * 2 * 64 + b.max_output * 2;
+  size_t fixed = BlockRing::memory + threads * per_thread + (1 << 20);
+  size_t min = fixed + (8 << 20);
+  if (limit < min)
+    die("--memory-limit must be at least " + std::to_string(min >> 20) +
+        " MiB for " + std::to_string(threads) + " threads");
+
+  // Half of the rest is for results. A block has about 100 bytes of
+  // views for each symbol, which can be every 3 bytes of text, so a
+  // quarter of the rest allows blocks of rest / 4 / 35 bytes. The line
+  // buffer grows by doubling, to twice that. The rest is for error
+  // records.
+  size_t rest = limit - fixed;
+  b.max_results = std::max<size_t>(rest / 2 / b.max_output, 1);
+  b.max_line = rest / 4 / 35;
+  b.max_errors = rest / 8;
+  return b;
+}
+
+// Demangles the file given by -f, one symbol per line. "-" is stdin.
+static int run_batch(const Options &opts) {
+  int in_fd = 0;
+  if (strcmp(opts.input, "-")) {
+    in_fd = open(opts.input, O_RDONLY);
+    if (in_fd < 0)
+      die_errno(opts.input);
+  }
+
+  int out_fd = 1;
+  if (opts.output) {
+    int flags = O_WRONLY | O_CREAT | (opts.resume ? 0 : O_TRUNC);
+    out_fd = open(opts.output, flags, 0666);
+    if (out_fd < 0)
+      die_errno(opts.output);
+  }
+
+  int index_fd = -1;
+  if (opts.shards) {
+    std::string path = std::string(opts.output) + ".idx";
+    index_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (index_fd < 0)
+      die_errno(path);
+    write_fd(index_fd, "shard " + std::to_string(opts.shard) + "/" +
+                           std::to_string(opts.shards) + "\n");
+  }
+
+  int err_fd = 2;
+  if (opts.errors && strcmp(opts.errors, "-")) {
+    int flags = O_WRONLY | O_CREAT | (opts.resume ? 0 : O_TRUNC);
+    err_fd = open(opts.errors, flags, 0666);
+    if (err_fd < 0)
+      die_errno(opts.errors);
+  }
+
+  // On resume, discard any output written after the checkpoint and
+  // continue from there.
+  Checkpoint pos;
+  if (opts.resume) {
+    pos = read_checkpoint(opts.checkpoint);
+    if (ftruncate(out_fd, pos.out) < 0 ||
+        lseek(out_fd, pos.out, SEEK_SET) < 0)
+      die_errno(opts.output);
+    if (opts.errors && err_fd != 2 &&
+        (ftruncate(err_fd, pos.err) < 0 ||
+         lseek(err_fd, pos.err, SEEK_SET) < 0))
+      die_errno(opts.errors);
+  }
+
+  // The pool has a thread per core, and the main thread demangles too.
+  MemoryStats mem;
+  MemoryBudget budget = plan_memory(
+      opts.memory_limit, std::max(std::thread::hardware_concurrency(), 1U) + 1);
+
+  // The log is declared first so that it outlives the writer.
+  std::unique_ptr<ErrorLog> log;
+  if (opts.errors)
+    log.reset(new ErrorLog(err_fd, opts.errors, budget.max_errors, mem));
+  BatchWriter w(opts, out_fd, index_fd, pos, log.get(), budget, mem);
+
+  // Regular files are mapped into memory unless they are compressed.
+  struct stat st;
+  if (fstat(in_fd, &st) < 0)
+    die_errno(opts.input);
+  char magic[4];
+  if (S_ISREG(st.st_mode)) {
+    ssize_t n = pread(in_fd, magic, sizeof(magic), 0);
+    if (detect_compression(String(magic, std::max<ssize_t>(n, 0))) ==
+        Uncompressed) {
+      run_mmap(in_fd, w, pos, opts);
+      w.checkpoint();
+      if (opts.stats)
+        write_stats(w, mem);
+      return w.num_failures() ? 1 : 0;
+    }
+  }
+
+  // Otherwise, read the first bytes to find out if the input is
+  // compressed.
+  std::string prefix;
+  while (prefix.size() < sizeof(magic)) {
+    ssize_t n = read(in_fd, magic, sizeof(magic) - prefix.size());
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      die_errno(opts.input);
+    if (n == 0)
+      break;
+    prefix.append(magic, n);
+  }
+  run_stream(make_reader(in_fd, opts.input, prefix), w, pos, opts, budget,
+             mem);
+  w.checkpoint();
+  if (opts.stats)
+    write_stats(w, mem);
+  return w.num_failures() ? 1 : 0;
+}
+
+// Maps a whole file into memory for reading.
+static String map_file(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    die_errno(path);
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    die_errno(path);
+  if (st.st_size == 0) {
+    close(fd);
+    return String();
+  }
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED)
+    die_errno(path);
+  close(fd);
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  return String((const char *)p, st.st_size);
+}
+
+// Sets line to the line of data at pos, without its '\n', and moves pos
+// past it. Returns false at the end of data.
+static bool next_line(String data, size_t &pos, String &line) {
+  if (pos >= data.len)
+    return false;
+  const char *nl =
+      (const char *)memchr(data.p + pos, '\n', data.len - pos);
+  size_t end = nl ? nl - data.p : data.len;
+  line = data.substr(pos, end - pos);
+  pos = nl ? end + 1 : end;
+  return true;
+}
+
+// Parses a decimal number that makes up all of s.
+static bool parse_uint(String s, uint64_t &n) {
+  n = 0;
+  for (size_t i = 0; i < s.len; ++i) {
+    if (s.p[i] < '0' || '9' < s.p[i])
+      return false;
+    n = n * 10 + (s.p[i] - '0');
+  }
+  return !s.empty();
+}
+
+// Parses "<i>/<n>" with i < n.
+static bool parse_shard(String s, unsigned &shard, unsigned &shards) {
+  const char *slash = (const char *)memchr(s.p, '/', s.len);
+  uint64_t i, n;
+  if (!slash || !parse_uint(s.substr(0, slash - s.p), i) ||
+      !parse_uint(s.substr(slash - s.p + 1), n) || i >= n || n > 1 << 20)
+    return false;
+  shard = i;
+  shards = n;
+  return true;
+}
+
+// The output of one --shard process and its index, mapped into memory.
+struct ShardFile {
+  explicit ShardFile(const char *path)
+      : path(path), out(map_file(path)),
+        index(map_file(std::string(path) + ".idx")) {
+    String header;
+    if (!next_line(index, index_pos, header) || !header.startswith("shard ") ||
+        !parse_shard(header.substr(6), shard, shards))
+      die(std::string(path) + ".idx: not a shard index");
+  }
+
+  // Reads the next line and its input offset. Returns false at the end.
+  bool next(String &line, uint64_t &offset) {
+    String num;
+    bool more = next_line(out, out_pos, line);
+    if (more != next_line(index, index_pos, num) ||
+        (more && !parse_uint(num, offset)))
+      die(std::string(path) + ".idx: doesn't match the output");
+    return more;
+  }
+
+  const char *path;
+  String out;
+  String index;
+  unsigned shard = 0;
+  unsigned shards = 0;
+  size_t out_pos = 0;
+  size_t index_pos = 0;
+};
+
+// Collects merged lines and writes them in large blocks.
+class LineWriter {
+public:
+  explicit LineWriter(int fd) : fd(fd) {}
+  ~LineWriter() { write_fd(fd, buf); }
+
+  void add(String line) {
+    buf.append(line.p, line.len);
+    buf += '\n';
+    if (buf.size() >= 1 << 20) {
+      write_fd(fd, buf);
+      buf.clear();
+    }
+  }
+
+private:
+  int fd;
+  std::string buf;
+};
+
+// Bytewise order, as in "LC_ALL=C sort".
+static bool less_bytes(String a, String b) {
+  int c = memcmp(a.p, b.p, std::min(a.len, b.len));
+  return c ? c < 0 : a.len < b.len;
+}
+
+// Each shard is in input order, so the shards are merged by the input
+// offsets in their indexes.
+static void merge_in_order(std::vector<ShardFile> &shards, int fd) {
+  typedef std::pair<uint64_t, size_t> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+  std::vector<String> lines(shards.size());
+  uint64_t off;
+  for (size_t i = 0; i < shards.size(); ++i)
+    if (shards[i].next(lines[i], off))
+      heap.push(Entry(off, i));
+
+  LineWriter w(fd);
+  while (!heap.empty()) {
+    size_t i = heap.top().second;
+    heap.pop();
+    w.add(lines[i]);
+    if (shards[i].next(lines[i], off))
+      heap.push(Entry(off, i));
+  }
+}
+
+// Sorts each shard into a run file on its own, so that only one shard
+// is in memory at a time, and then merges the runs.
+static void merge_sorted(std::vector<ShardFile> &shards, int fd) {
+  std::vector<std::string> paths;
+  std::vector<String> runs;
+  for (ShardFile &shard : shards) {
+    std::vector<String> lines;
+    String line;
+    for (size_t pos = 0; next_line(shard.out, pos, line);)
+      lines.push_back(line);
+    std::sort(lines.begin(), lines.end(), less_bytes);
+
+    paths.push_back(std::string(shard.path) + ".sorted");
+    int run_fd = open(paths.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (run_fd < 0)
+      die_errno(paths.back());
+    {
+      LineWriter w(run_fd);
+      for (String l : lines)
+        w.add(l);
+    }
+    close(run_fd);
+    runs.push_back(map_file(paths.back()));
+  }
+
+  // Equal lines are taken from the earlier run first.
+  typedef std::pair<String, size_t> Entry;
+  auto later = [](const Entry &a, const Entry &b) {
+    if (less_bytes(b.first, a.first))
+      return true;
+    return !less_bytes(a.first, b.first) && b.second < a.second;
+  };
+  std::priority_queue<Entry, std::vector<Entry>, decltype(later)> heap(later);
+  std::vector<size_t> pos(runs.size());
+  String line;
+  for (size_t i = 0; i < runs.size(); ++i)
+    if (next_line(runs[i], pos[i], line))
+      heap.push(Entry(line, i));
+
+  {
+    LineWriter w(fd);
+    while (!heap.empty()) {
+      Entry e = heap.top();
+      heap.pop();
+      w.add(e.first);
+      if (next_line(runs[e.second], pos[e.second], line))
+        heap.push(Entry(line, e.second));
+    }
+  }
+  for (const std::string &path : paths)
+    unlink(path.c_str());
+}
+
+[[noreturn]] static void usage(const char *argv0);
+
+// undname merge [--sort] [-o <file>] <file>...
+static int run_merge(int argc, char **argv) {
+  bool sort = false;
+  const char *output = nullptr;
+  std::vector<ShardFile> shards;
+  for (int i = 2; i < argc; ++i) {
+    String arg = argv[i];
+    if (arg == "--sort")
+      sort = true;
+    else if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (!arg.startswith('-'))
+      shards.emplace_back(argv[i]);
+    else
+      usage(argv[0]);
+  }
+  if (shards.empty())
+    usage(argv[0]);
+
+  // All n shards must be there, once each.
+  unsigned n = shards[0].shards;
+  std::vector<const char *> seen(n);
+  for (const ShardFile &s : shards) {
+    if (s.shards != n)
+      die(std::string(s.path) + ": shard of " + std::to_string(s.shards) +
+          ", not " + std::to_string(n));
+    if (seen[s.shard])
+      die(std::string(s.path) + ": same shard as " + seen[s.shard]);
+    seen[s.shard] = s.path;
+  }
+  for (unsigned i = 0; i < n; ++i)
+    if (!seen[i])
+      die("missing shard " + std::to_string(i) + "/" + std::to_string(n));
+
+  int fd = 1;
+  if (output) {
+    fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+      die_errno(output);
+  }
+  if (sort)
+    merge_sorted(shards, fd);
+  else
+    merge_in_order(shards, fd);
+  return 0;
+}
+
+[[noreturn]] static void usage(const char *argv0) {
+  write_fd(1, std::string(argv0) +
+                  " [-m32|-m64] <symbol>\n" + argv0 +
+                  " [-m32|-m64] -f <file> [-o <file>] [--checkpoint <file>]"
+                  " [--checkpoint-every <n>] [--resume]"
+                  " [--format auto|lines|nm|dumpbin|text] [--validate]"
+                  " [--errors <file>] [--stats] [--memory-limit <MiB>]"
+                  " [--huge-pages off|thp|explicit] [--shard <i>/<n>]\n" +
+                  argv0 + " merge [--sort] [-o <file>] <file>...\n");
+  exit(1);
+}
+
+static TextFormat parse_format(String s, const char *argv0) {
+  if (s == "auto")
+    return FormatAuto;
+  if (s == "lines")
+    return FormatLines;
+  if (s == "nm")
+    return FormatNm;
+  if (s == "dumpbin")
+    return FormatDumpbin;
+  if (s == "text")
+    return FormatText;
+  usage(argv0);
+}
+
+static HugePages parse_huge_pages(String s, const char *argv0) {
+  if (s == "off")
+    return HugePagesOff;
+  if (s == "thp")
+    return HugePagesTransparent;
+  if (s == "explicit")
+    return HugePagesExplicit;
+  usage(argv0);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && String(argv[1]) == "merge")
+    return run_merge(argc, argv);
+
+  Options opts;
+  for (int i = 1; i < argc; ++i) {
+    String arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "-m32")
+      opts.model = Ptr32;
+    else if (arg == "-m64")
+      opts.model = Ptr64;
+    else if (arg == "-f" && has_value)
+      opts.input = argv[++i];
+    else if (arg == "-o" && has_value)
+      opts.output = argv[++i];
+    else if (arg == "--checkpoint" && has_value)
+      opts.checkpoint = argv[++i];
+    else if (arg == "--checkpoint-every" && has_value)
+      opts.checkpoint_every = std::max(1L, atol(argv[++i]));
+    else if (arg == "--resume")
+      opts.resume = true;
+    else if (arg == "--validate")
+      opts.validate = true;
+    else if (arg == "--errors" && has_value)
+      opts.errors = argv[++i];
+    else if (arg == "--stats")
+      opts.stats = true;
+    else if (arg == "--memory-limit" && has_value)
+      opts.memory_limit = (size_t)std::max(1L, atol(argv[++i])) << 20;
+    else if (arg == "--huge-pages" && has_value)
+      opts.huge_pages = parse_huge_pages(argv[++i], argv[0]);
+    else if (arg == "--shard" && has_value) {
+      if (!parse_shard(argv[++i], opts.shard, opts.shards))
+        die("--shard must be <i>/<n> with i < n");
+    } else if (arg == "--format" && has_value)
+      opts.format = parse_format(argv[++i], argv[0]);
+    else if (!opts.symbol && !arg.startswith('-'))
+      opts.symbol = argv[i];
+    else
+      usage(argv[0]);
+  }
+
+  if (opts.input) {
+    if (opts.symbol)
+      usage(argv[0]);
+    if (opts.checkpoint && !opts.output)
+      die("--checkpoint requires -o");
+    if (opts.resume && !opts.checkpoint)
+      die("--resume requires --checkpoint");
+    if (opts.errors && opts.validate)
+      die("--errors can't be used with --validate");
+    if (opts.shards && !opts.output)
+      die("--shard requires -o");
+    if (opts.shards && (opts.validate || opts.checkpoint))
+      die("--shard can't be used with --validate or --checkpoint");
+    return run_batch(opts);
+  }
+
+  if (!opts.symbol || opts.output || opts.checkpoint || opts.resume ||
+      opts.validate || opts.errors || opts.stats || opts.memory_limit ||
+      opts.huge_pages || opts.shards)
+    usage(argv[0]);
+
+  std::string out;
+  Error err;
+  if (!demangle(String(opts.symbol), out, &err, opts.model)) {
+    write_fd(2, err.str() + "\n");
+    return 1;
+  }
+
+  write_fd(1, out + "\n");
+  return 0;
+}